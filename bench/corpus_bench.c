@@ -0,0 +1,279 @@
+/*
+ * Benchmark of ais_decode() over a corpus, by message type.
+ *
+ * The corpus (bench/corpus.nmea by default) is decoded once to group its
+ * sentences by the type of the message they complete. Then each group is
+ * decoded repeatedly through a fresh handle, and the fastest of several
+ * rounds is reported in nanoseconds and sentences per second, with the
+ * heap allocations made per sentence.
+ *
+ * With --baseline FILE, the report is compared with an earlier one saved
+ * to FILE, and the exit status is 1 if any type got slower by more than
+ * --threshold percent (10 by default).
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "aisdecoder.h"
+
+#define TYPES	AIS_STATS_TYPES
+#define ALL	TYPES		/* the row for the whole corpus */
+
+#ifdef __GLIBC__
+/* count heap allocations by wrapping the glibc allocator */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static unsigned long allocations;
+
+void *malloc(size_t size)
+{
+    allocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    allocations++;
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    allocations++;
+    return __libc_realloc(ptr, size);
+}
+#define ALLOCATIONS()	allocations
+#else
+#define ALLOCATIONS()	0ul
+#endif
+
+struct group {
+    char *buf;			/* the sentences, newline-terminated */
+    size_t len, size;
+    unsigned long sentences, messages;
+    double ns;			/* fastest round, per sentence */
+    double allocations;		/* per sentence */
+};
+
+static struct group groups[TYPES + 1];
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void append(struct group *g, const char *line, size_t len)
+{
+    if (g->len + len + 1 > g->size) {
+	g->size = (g->len + len + 1) * 2;
+	g->buf = realloc(g->buf, g->size);
+	if (g->buf == NULL) {
+	    perror("realloc");
+	    exit(2);
+	}
+    }
+    memcpy(g->buf + g->len, line, len);
+    g->len += len;
+    g->buf[g->len++] = '\n';
+    g->sentences++;
+}
+
+static char *read_file(const char *path, size_t *len)
+{
+    FILE *fp = fopen(path, "rb");
+    char *buf;
+    long size;
+
+    if (fp == NULL) {
+	perror(path);
+	exit(2);
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    buf = malloc(size + 1);
+    if (buf == NULL || fread(buf, 1, size, fp) != (size_t)size) {
+	perror(path);
+	exit(2);
+    }
+    fclose(fp);
+    *len = size;
+    return buf;
+}
+
+static void classify(const char *buf, size_t len)
+/* group the sentences by the type of the message each one goes into */
+{
+    ais_handle_t *handle = ais_create_handle();
+    const char *line = buf, *end = buf + len;
+    const char *pending = buf;	/* sentences of the next message start here */
+    struct ais_t ais;
+
+    while (line < end) {
+	const char *nl = memchr(line, '\n', end - line);
+	const char *next = nl != NULL ? nl + 1 : end;
+	size_t n = (nl != NULL ? nl : end) - line;
+
+	if (n > 0 && line[n - 1] == '\r')
+	    n--;
+	if (n > 0 && ais_decode(handle, line, n, &ais, false, LOG_ERROR)) {
+	    /* the message's earlier fragments, or a type 24 part A, too */
+	    const char *cp = pending;
+	    while (cp < next) {
+		const char *e = memchr(cp, '\n', next - cp);
+		size_t m = (e != NULL ? e : next) - cp;
+		if (m > 0 && cp[m - 1] == '\r')
+		    m--;
+		if (m > 0) {
+		    append(&groups[ais.type], cp, m);
+		    append(&groups[ALL], cp, m);
+		}
+		cp = e != NULL ? e + 1 : next;
+	    }
+	    groups[ais.type].messages++;
+	    groups[ALL].messages++;
+	    pending = next;
+	}
+	line = next;
+    }
+    if (pending < end)
+	fprintf(stderr, "warning: sentences at the end decode to nothing\n");
+    ais_destroy_handle(handle);
+}
+
+static void count(const struct ais_t *ais, void *userdata)
+{
+    (void)ais;
+    ++*(unsigned long *)userdata;
+}
+
+static void measure(struct group *g, int rounds)
+/* decode the group in rounds of at least 50 ms, keeping the fastest */
+{
+    long iterations = 1;
+    int round;
+
+    /* size a round */
+    for (;;) {
+	ais_handle_t *handle = ais_create_handle();
+	unsigned long decoded = 0;
+	double start = now(), elapsed;
+	long i;
+
+	for (i = 0; i < iterations; i++)
+	    ais_decode_lines(handle, g->buf, g->len, count, &decoded,
+			     false, LOG_ERROR);
+	elapsed = now() - start;
+	ais_destroy_handle(handle);
+	if (elapsed >= 0.05)
+	    break;
+	iterations = elapsed > 0.005 ? (long)(iterations * 0.06 / elapsed) + 1
+	    : iterations * 10;
+    }
+
+    g->ns = 0;
+    for (round = 0; round < rounds; round++) {
+	ais_handle_t *handle = ais_create_handle();
+	unsigned long decoded = 0, before = ALLOCATIONS();
+	double start = now(), ns;
+	long i;
+
+	for (i = 0; i < iterations; i++)
+	    ais_decode_lines(handle, g->buf, g->len, count, &decoded,
+			     false, LOG_ERROR);
+	ns = (now() - start) * 1e9 / ((double)iterations * g->sentences);
+	g->allocations = (double)(ALLOCATIONS() - before)
+	    / ((double)iterations * g->sentences);
+	ais_destroy_handle(handle);
+	if (g->ns == 0 || ns < g->ns)
+	    g->ns = ns;
+    }
+}
+
+static void label(char *buf, size_t size, int type)
+{
+    if (type == ALL)
+	snprintf(buf, size, "all");
+    else
+	snprintf(buf, size, "%d", type);
+}
+
+static bool baseline_ns(const char *path, const char *key, double *ns)
+/* the ns/sentence of a row in an earlier report */
+{
+    char line[256], name[32];
+    double value;
+    FILE *fp = fopen(path, "r");
+    bool found = false;
+
+    if (fp == NULL) {
+	perror(path);
+	exit(2);
+    }
+    while (!found && fgets(line, sizeof(line), fp) != NULL)
+	if (sscanf(line, "%31s %*s %*s %lf", name, &value) == 2
+	    && strcmp(name, key) == 0) {
+	    *ns = value;
+	    found = true;
+	}
+    fclose(fp);
+    return found;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = "bench/corpus.nmea", *baseline = NULL;
+    double threshold = 10;
+    int rounds = 5, type, regressions = 0;
+    char *buf, key[16];
+    size_t len;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+	if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc)
+	    rounds = atoi(argv[++i]);
+	else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+	    baseline = argv[++i];
+	else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+	    threshold = atof(argv[++i]);
+	else if (argv[i][0] != '-')
+	    path = argv[i];
+	else {
+	    fprintf(stderr, "usage: %s [--rounds N] [--baseline FILE] "
+		    "[--threshold PERCENT] [corpus]\n", argv[0]);
+	    return 2;
+	}
+    }
+
+    buf = read_file(path, &len);
+    classify(buf, len);
+
+    printf("%-4s %9s %9s %11s %12s %15s%s\n", "type", "sentences",
+	   "messages", "ns/sentence", "sentences/s", "allocs/sentence",
+	   baseline != NULL ? "  vs baseline" : "");
+    for (type = 0; type <= ALL; type++) {
+	struct group *g = &groups[type];
+	double before;
+
+	if (g->sentences == 0)
+	    continue;
+	measure(g, rounds);
+	label(key, sizeof(key), type);
+	printf("%-4s %9lu %9lu %11.1f %12.0f %15.2f", key, g->sentences,
+	       g->messages, g->ns, 1e9 / g->ns, g->allocations);
+	if (baseline != NULL && baseline_ns(baseline, key, &before)) {
+	    double change = (g->ns - before) * 100 / before;
+	    printf("  %+10.1f%%%s", change, change > threshold ? " SLOWER" : "");
+	    regressions += change > threshold;
+	}
+	printf("\n");
+    }
+    return regressions > 0;
+}
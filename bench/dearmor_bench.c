@@ -0,0 +1,151 @@
+/*
+ * Microbenchmark for AIVDM payload de-armoring.
+ *
+ * Compares aivdm_dearmor(), with its scalar and SIMD paths, against the
+ * original bit-at-a-time loop from aivdm_decode(), checking that all of
+ * them produce identical bits/bitlen.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "aivdm_decode.h"
+
+static void dearmor_reference(unsigned char *bits, size_t *bitlen,
+			      const unsigned char *data, size_t len)
+{
+    const unsigned char *cp;
+    unsigned char ch;
+    int i;
+
+    for (cp = data; cp < data + len; cp++) {
+	ch = *cp;
+	ch -= 48;
+	if (ch >= 40)
+	    ch -= 8;
+	for (i = 5; i >= 0; i--) {
+	    if ((ch >> i) & 0x01)
+		bits[*bitlen / 8] |= (1 << (7 - *bitlen % 8));
+	    (*bitlen)++;
+	}
+    }
+}
+
+typedef void (*dearmor_fn)(unsigned char *, size_t *,
+			   const unsigned char *, size_t);
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* de-armor the fragments of one message, as aivdm_decode() would */
+static size_t run(dearmor_fn fn, unsigned char *bits,
+		  const char **frags, int nfrags)
+{
+    size_t bitlen = 0;
+    int i;
+
+    memset(bits, 0, 256);
+    for (i = 0; i < nfrags; i++)
+	fn(bits, &bitlen, (const unsigned char *)frags[i], strlen(frags[i]));
+    return bitlen;
+}
+
+static double bench(dearmor_fn fn, const char **frags, int nfrags, long iterations)
+{
+    unsigned char bits[256 + 8];
+    volatile size_t sink = 0;
+    double start = now();
+    long i;
+
+    for (i = 0; i < iterations; i++)
+	sink += run(fn, bits, frags, nfrags) + bits[i % 16];
+    (void)sink;
+    return (now() - start) * 1e9 / iterations;
+}
+
+static int check(const char **frags, int nfrags)
+{
+    unsigned char expected[256 + 8], actual[256 + 8];
+    size_t expectedlen = run(dearmor_reference, expected, frags, nfrags);
+    size_t actuallen = run(aivdm_dearmor, actual, frags, nfrags);
+
+    return expectedlen == actuallen &&
+	memcmp(expected, actual, (expectedlen + 7) / 8) == 0;
+}
+
+static int fuzz(void)
+{
+    static const char alphabet[] =
+	"0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVW`abcdefghijklmnopqrstuvw";
+    char buf[4][96];
+    const char *frags[4];
+    int round, i, j;
+
+    srand(1);
+    for (round = 0; round < 100000; round++) {
+	int nfrags = 1 + rand() % 4;
+	for (i = 0; i < nfrags; i++) {
+	    int len = rand() % 90;
+	    for (j = 0; j < len; j++)
+		buf[i][j] = rand() % 64 == 0 ? (char)(1 + rand() % 255)
+		    : alphabet[rand() % 64];
+	    buf[i][len] = '\0';
+	    frags[i] = buf[i];
+	}
+	if (!check(frags, nfrags))
+	    return 0;
+    }
+    return 1;
+}
+
+static void report(const char *label, const char **frags, int nfrags,
+		   long iterations)
+{
+    double ref, scalar, simd;
+    const char *kernel;
+
+    ref = bench(dearmor_reference, frags, nfrags, iterations);
+    (void)aivdm_dearmor_select(false);
+    scalar = bench(aivdm_dearmor, frags, nfrags, iterations);
+    kernel = aivdm_dearmor_select(true);
+    simd = bench(aivdm_dearmor, frags, nfrags, iterations);
+    printf("%s: reference %6.1f ns, table %6.1f ns (%.1fx), %s %6.1f ns (%.1fx)\n",
+	   label, ref, scalar, ref / scalar, kernel, simd, ref / simd);
+}
+
+int main(int argc, char *argv[])
+{
+    static const char *type1[] = { "177KQJ5000G?tO`K>RA1wUbN0TKH" };
+    static const char *type5[] = {
+	"55?MbV02;H;s<HtKR20EHE:0@T4@Dn2222222216L961O5Gf0NSQEp6ClRp8",
+	"88888888880",
+    };
+    static const char *type8[] = {
+	"85Mwp`1Kf3aCnsNvBWLi=wQuNhA5t43N`5nCuI=p<IBfVqnMgPGs",
+	"85Mwp`1Kf3aCnsNvBWLi=wQuNhA5t43N`5nCuI=p<IBfVqnMgPGs",
+	"85Mwp`1Kf3aCnsNvBWLi=wQuNhA5t43N`5nCuI=p<IBfVqnMgPGs",
+    };
+    long iterations = argc > 1 ? atol(argv[1]) : 5000000;
+    bool simd;
+
+    for (simd = false; ; simd = true) {
+	(void)aivdm_dearmor_select(simd);
+	if (!check(type1, 1) || !check(type5, 2) || !check(type8, 3) || !fuzz()) {
+	    fprintf(stderr, "aivdm_dearmor() output differs from reference\n");
+	    return 1;
+	}
+	if (simd)
+	    break;
+    }
+
+    report("type 1", type1, 1, iterations);
+    report("type 5", type5, 2, iterations);
+    report("type 8", type8, 3, iterations);
+    return 0;
+}
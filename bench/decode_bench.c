@@ -0,0 +1,113 @@
+/*
+ * Microbenchmark for aivdm_decode(), the per-sentence decode path.
+ *
+ * Times decoding of a few kinds of traffic through one session, in
+ * nanoseconds per sentence, into struct ais_t (with and without checksum
+ * verification) and into compact position records.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "aivdm_decode.h"
+#include "gpsd.h"
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double bench(const char **sentences, int n, long iterations,
+		    bool checksum, int *decoded)
+{
+    static struct gps_device_t session;
+    static struct gps_context_t context;
+    struct ais_t ais;
+    size_t lens[8];
+    double start;
+    long i;
+    int j;
+
+    memset(&session, 0, sizeof(session));
+    context.debug = LOG_ERROR;
+    session.context = &context;
+    session.driver.aivdm.verify_checksum = checksum;
+    for (j = 0; j < n; j++)
+	lens[j] = strlen(sentences[j]);
+
+    *decoded = 0;
+    start = now();
+    for (i = 0; i < iterations; i++)
+	for (j = 0; j < n; j++)
+	    *decoded += aivdm_decode(sentences[j], lens[j], &session, &ais,
+				     false, LOG_ERROR);
+    return (now() - start) * 1e9 / ((double)iterations * n);
+}
+
+static double bench_positions(const char **sentences, int n, long iterations,
+			      int *decoded)
+{
+    static struct gps_device_t session;
+    static struct gps_context_t context;
+    struct ais_position_t pos;
+    size_t lens[8];
+    double start;
+    long i;
+    int j;
+
+    memset(&session, 0, sizeof(session));
+    context.debug = LOG_ERROR;
+    session.context = &context;
+    for (j = 0; j < n; j++)
+	lens[j] = strlen(sentences[j]);
+
+    *decoded = 0;
+    start = now();
+    for (i = 0; i < iterations; i++)
+	for (j = 0; j < n; j++)
+	    *decoded += aivdm_decode_position(sentences[j], lens[j], &session,
+					      &pos);
+    return (now() - start) * 1e9 / ((double)iterations * n);
+}
+
+enum mode { AIS, CHECKSUM, POSITIONS };
+
+static void report(const char *label, const char **sentences, int n,
+		   long iterations, enum mode mode)
+{
+    int decoded;
+    double ns = mode == POSITIONS
+	? bench_positions(sentences, n, iterations, &decoded)
+	: bench(sentences, n, iterations, mode == CHECKSUM, &decoded);
+
+    printf("%s: %6.1f ns/sentence (%d messages)\n", label, ns, decoded);
+}
+
+int main(int argc, char *argv[])
+{
+    static const char *type1[] = {
+	"!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C",
+	"!AIVDM,1,1,,A,13u?etPv2;0n:dDPwUM1U1Cb069D,0*24",
+    };
+    static const char *type5[] = {
+	"!AIVDM,2,1,1,A,55?MbV02;H;s<HtKR20EHE:0@T4@Dn2222222216L961O5Gf0NSQEp6ClRp8,0*1C",
+	"!AIVDM,2,2,1,A,88888888880,2*25",
+    };
+    static const char *type18[] = {
+	"!AIVDM,1,1,,B,B69>7mh0?J<:>05B0`0e;wq2PHI8,0*3D",
+    };
+    long iterations = argc > 1 ? atol(argv[1]) : 2000000;
+
+    report("type 1 ", type1, 2, iterations, AIS);
+    report("type 5 ", type5, 2, iterations, AIS);
+    report("type 18", type18, 1, iterations, AIS);
+    report("type 1  checksum verified", type1, 2, iterations, CHECKSUM);
+    report("type 5  checksum verified", type5, 2, iterations, CHECKSUM);
+    report("type 1  position record", type1, 2, iterations, POSITIONS);
+    report("type 18 position record", type18, 1, iterations, POSITIONS);
+    return 0;
+}
@@ -0,0 +1,105 @@
+/*
+ * Benchmark of AisDecoder.decode() over a corpus, by message type; the JS
+ * counterpart of corpus_bench.c, including convertToJS().
+ *
+ * Usage: node --expose-gc bench/decode_bench.js [corpus]
+ *
+ * Reports the fastest of 5 rounds of at least 50 ms in nanoseconds and
+ * sentences per second, and the JS heap allocated per sentence, measured
+ * over a pass short enough not to be interrupted by garbage collection.
+ * Without --expose-gc the heap column is left out.
+ */
+var fs = require('fs');
+var path = require('path');
+var AisDecoder = require('../').AisDecoder;
+
+var ROUNDS = 5;
+
+function now() {
+  var t = process.hrtime();
+  return t[0] + t[1] / 1e9;
+}
+
+// The message type, from the first payload character of its first sentence
+function messageType(sentence) {
+  var c = sentence.split(',')[5].charCodeAt(0) - 48;
+  return c > 40 ? c - 8 : c;
+}
+
+// Group the sentences by the type of the message each one goes into
+function classify(lines) {
+  var decoder = new AisDecoder();
+  var groups = { all: { sentences: [], messages: 0 } };
+  var pending = [];
+  lines.forEach(function(line) {
+    if (!line) return;
+    pending.push(line);
+    if (!decoder.decode(line)) return;
+    var type = messageType(pending[0]);
+    var group = groups[type] || (groups[type] = { sentences: [], messages: 0 });
+    group.sentences = group.sentences.concat(pending);
+    group.messages++;
+    groups.all.sentences = groups.all.sentences.concat(pending);
+    groups.all.messages++;
+    pending = [];
+  });
+  return groups;
+}
+
+function decodeAll(decoder, sentences) {
+  for (var i = 0; i < sentences.length; i++) decoder.decode(sentences[i]);
+}
+
+function measure(sentences) {
+  var iterations = 1, round, elapsed, start, ns, best = 0;
+  for (;;) {
+    var decoder = new AisDecoder();
+    start = now();
+    for (var i = 0; i < iterations; i++) decodeAll(decoder, sentences);
+    elapsed = now() - start;
+    if (elapsed >= 0.05) break;
+    iterations = elapsed > 0.005 ? Math.ceil(iterations * 0.06 / elapsed) : iterations * 10;
+  }
+  for (round = 0; round < ROUNDS; round++) {
+    var decoder = new AisDecoder();
+    start = now();
+    for (var i = 0; i < iterations; i++) decodeAll(decoder, sentences);
+    ns = (now() - start) * 1e9 / (iterations * sentences.length);
+    if (!best || ns < best) best = ns;
+  }
+
+  var heap;
+  if (typeof gc === 'function') {
+    var decoder = new AisDecoder();
+    var passes = Math.max(1, Math.floor(200 / sentences.length));
+    gc();
+    var before = process.memoryUsage().heapUsed;
+    for (var i = 0; i < passes; i++) decodeAll(decoder, sentences);
+    heap = (process.memoryUsage().heapUsed - before) / (passes * sentences.length);
+  }
+  return { ns: best, heap: heap };
+}
+
+function pad(s, width) {
+  s = String(s);
+  while (s.length < width) s = ' ' + s;
+  return s;
+}
+
+var corpus = process.argv[2] || path.join(__dirname, 'corpus.nmea');
+var groups = classify(fs.readFileSync(corpus, 'utf8').split(/\r?\n/));
+var keys = Object.keys(groups).filter(function(k) { return k !== 'all'; })
+  .sort(function(a, b) { return a - b; }).concat(['all']);
+
+console.log('type sentences  messages ns/sentence  sentences/s' +
+            (typeof gc === 'function' ? '  heap bytes/sentence' : ''));
+keys.forEach(function(key) {
+  var group = groups[key];
+  var result = measure(group.sentences);
+  console.log((key + '    ').slice(0, 4) + ' ' +
+              pad(group.sentences.length, 9) + ' ' +
+              pad(group.messages, 9) + ' ' +
+              pad(result.ns.toFixed(1), 11) + ' ' +
+              pad((1e9 / result.ns).toFixed(0), 12) +
+              (result.heap !== undefined ? ' ' + pad(result.heap.toFixed(0), 20) : ''));
+});
@@ -0,0 +1,309 @@
+/*
+ * Synthetic AIS traffic through ais_encode(): a load generator and its
+ * benchmark.
+ *
+ * A fleet of vessels steams around the North Sea. Class A ships send
+ * position reports (types 1-3) and now and then their static and voyage
+ * data (type 5); class B ships send types 18 and 24 (part A, then B).
+ * Base stations (type 4) and aids to navigation (type 21) join in.
+ *
+ * By default a few thousand messages are generated, encoded in rounds of
+ * at least 50 ms, and the fastest round is reported in messages and
+ * sentences per second. Every message is then decoded again and
+ * re-encoded, and the exit status is 1 if any does not come back the same.
+ *
+ * With --print N, N messages are generated and their sentences written to
+ * stdout instead, to feed other programs.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "aisdecoder.h"
+
+#define MESSAGES	4096	/* generated for benchmarking */
+#define FLEET		512
+#define STATIONS	8	/* base stations and aids to navigation each */
+
+struct vessel {
+    unsigned int mmsi;
+    bool class_b;
+    int lon, lat;		/* 1/10000 minutes */
+    unsigned int speed;		/* 1/10 knots */
+    unsigned int course;	/* 1/10 degrees */
+    unsigned int messages;
+};
+
+static struct vessel fleet[FLEET];
+static uint64_t rng = 0x9e3779b97f4a7c15ull;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned int random_below(unsigned int n)
+/* xorshift64*, reproducible from run to run */
+{
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    return (unsigned int)(((rng * 0x2545f4914f6cdd1dull) >> 32) % n);
+}
+
+static void random_name(char *to, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++)
+	to[i] = (char)('A' + random_below(26));
+    to[len] = '\0';
+}
+
+static void launch(void)
+{
+    int i;
+
+    for (i = 0; i < FLEET; i++) {
+	struct vessel *v = &fleet[i];
+
+	v->class_b = random_below(4) == 0;
+	v->mmsi = 200000000 + random_below(600000000);
+	/* 51-56 N, 1-8 E */
+	v->lat = (51 * 60 + (int)random_below(5 * 60)) * 10000;
+	v->lon = (1 * 60 + (int)random_below(7 * 60)) * 10000;
+	v->speed = v->class_b ? random_below(250) : random_below(220);
+	v->course = random_below(3600);
+    }
+}
+
+static void steam(struct vessel *v)
+/* move a vessel on by the interval between its reports, about 10 s */
+{
+    /* 1 knot for 10 s is 1/360 minute of latitude, or 27.8 units */
+    int distance = (int)v->speed * 278 / 100;
+    int dir = (int)v->course / 900;
+
+    v->lat += dir == 0 || dir == 3 ? distance : -distance;
+    v->lon += dir < 2 ? distance : -distance;
+    /* turn back at the edge of the area */
+    if (v->lat < 51 * 600000 || v->lat > 56 * 600000
+	|| v->lon < 1 * 600000 || v->lon > 8 * 600000)
+	v->course = (v->course + 1800) % 3600;
+    if (random_below(16) == 0)
+	v->course = (v->course + 3600 - 50 + random_below(101)) % 3600;
+}
+
+static void generate(struct ais_t *ais, unsigned long n)
+/* the next message of the synthetic traffic */
+{
+    struct vessel *v = &fleet[random_below(FLEET)];
+    unsigned long t = n / 50;	/* seconds, at 50 messages a second */
+
+    memset(ais, 0, sizeof(*ais));
+    if (n % 97 == 0) {
+	ais->type = 4;
+	ais->mmsi = 2190000 + (unsigned int)(n % STATIONS);
+	ais->type4.year = 2024;
+	ais->type4.month = 5;
+	ais->type4.day = 1 + (unsigned int)(t / 86400 % 28);
+	ais->type4.hour = (unsigned int)(t / 3600 % 24);
+	ais->type4.minute = (unsigned int)(t / 60 % 60);
+	ais->type4.second = (unsigned int)(t % 60);
+	ais->type4.accuracy = true;
+	ais->type4.lon = 300000 + (int)(n % STATIONS) * 60000;
+	ais->type4.lat = 3300000;
+	ais->type4.epfd = 7;
+	ais->type4.radio = random_below(1u << 19);
+	return;
+    }
+    if (n % 211 == 0) {
+	ais->type = 21;
+	ais->mmsi = 992190000 + (unsigned int)(n % STATIONS);
+	ais->type21.aid_type = 1 + random_below(31);
+	/* some names run into the extension */
+	random_name(ais->type21.name, 8 + random_below(27));
+	ais->type21.lon = 360000 + (int)(n % STATIONS) * 30000;
+	ais->type21.lat = 3200000;
+	ais->type21.to_bow = 5;
+	ais->type21.to_stern = 5;
+	ais->type21.to_port = 3;
+	ais->type21.to_starboard = 3;
+	ais->type21.epfd = 7;
+	ais->type21.second = (unsigned int)(t % 60);
+	ais->type21.virtual_aid = random_below(4) == 0;
+	return;
+    }
+
+    steam(v);
+    ais->mmsi = v->mmsi;
+    if (v->class_b) {
+	if (v->messages++ % 20 == 19) {
+	    ais->type = 24;
+	    ais->type24.part = random_below(2) == 0 ? part_a : part_b;
+	    random_name(ais->type24.shipname, 4 + random_below(17));
+	    ais->type24.shiptype = 37;
+	    random_name(ais->type24.vendorid, 3);
+	    ais->type24.model = random_below(16);
+	    ais->type24.serial = random_below(1u << 20);
+	    random_name(ais->type24.callsign, 5);
+	    ais->type24.dim.to_bow = 6;
+	    ais->type24.dim.to_stern = 4;
+	    ais->type24.dim.to_port = 2;
+	    ais->type24.dim.to_starboard = 2;
+	    return;
+	}
+	ais->type = 18;
+	ais->type18.reserved = 0;
+	ais->type18.speed = v->speed;
+	ais->type18.accuracy = random_below(2) == 0;
+	ais->type18.lon = v->lon;
+	ais->type18.lat = v->lat;
+	ais->type18.course = v->course;
+	ais->type18.heading = v->course / 10;
+	ais->type18.second = (unsigned int)(t % 60);
+	ais->type18.cs = true;
+	ais->type18.band = true;
+	ais->type18.msg22 = true;
+	ais->type18.radio = random_below(1u << 20);
+	return;
+    }
+    if (v->messages++ % 20 == 19) {
+	ais->type = 5;
+	ais->type5.imo = 9000000 + random_below(999999);
+	random_name(ais->type5.callsign, 4 + random_below(4));
+	random_name(ais->type5.shipname, 6 + random_below(15));
+	ais->type5.shiptype = 70 + random_below(20);
+	ais->type5.to_bow = 20 + random_below(200);
+	ais->type5.to_stern = 10 + random_below(50);
+	ais->type5.to_port = 5 + random_below(15);
+	ais->type5.to_starboard = 5 + random_below(15);
+	ais->type5.epfd = 1;
+	ais->type5.month = 1 + random_below(12);
+	ais->type5.day = 1 + random_below(28);
+	ais->type5.hour = random_below(24);
+	ais->type5.minute = random_below(60);
+	ais->type5.draught = 30 + random_below(150);
+	random_name(ais->type5.destination, 5 + random_below(16));
+	return;
+    }
+    ais->type = 1 + random_below(3);
+    ais->type1.status = v->speed < 5 ? 5 : 0;
+    ais->type1.turn = random_below(4) == 0 ? -128 : (int)random_below(21) - 10;
+    ais->type1.speed = v->speed;
+    ais->type1.accuracy = random_below(2) == 0;
+    ais->type1.lon = v->lon;
+    ais->type1.lat = v->lat;
+    ais->type1.course = v->course;
+    ais->type1.heading = v->course / 10;
+    ais->type1.second = (unsigned int)(t % 60);
+    ais->type1.radio = random_below(1u << 19);
+}
+
+static size_t encode(const struct ais_t *ais, unsigned long n, char *buf,
+		     size_t *sentences)
+{
+    size_t len = ais_encode(ais, n % 2 ? 'B' : 'A', (unsigned int)n, buf,
+			    AIS_ENCODE_MAX_LEN);
+    const char *cp;
+
+    if (len == 0) {
+	fprintf(stderr, "type %u message not encoded\n", ais->type);
+	exit(2);
+    }
+    for (cp = buf; (cp = strchr(cp, '\n')) != NULL; cp++)
+	++*sentences;
+    return len;
+}
+
+static bool round_trip(const struct ais_t *ais, unsigned long n)
+/* do the sentences decode to a message which encodes the same? */
+{
+    char buf[AIS_ENCODE_MAX_LEN], again[AIS_ENCODE_MAX_LEN];
+    ais_handle_t *handle = ais_create_handle();
+    struct ais_t decoded;
+    const char *cp, *nl;
+    int messages = 0;
+    size_t sentences = 0;
+
+    ais_set_verify_checksum(handle, true);
+    (void)encode(ais, n, buf, &sentences);
+    for (cp = buf; (nl = strchr(cp, '\n')) != NULL; cp = nl + 1)
+	messages += ais_decode(handle, cp, (size_t)(nl - cp), &decoded, true,
+			       LOG_ERROR);
+    ais_destroy_handle(handle);
+    if (messages != 1 || decoded.mmsi != ais->mmsi) {
+	fprintf(stderr, "did not decode: %s", buf);
+	return false;
+    }
+    (void)encode(&decoded, n, again, &sentences);
+    if (strcmp(buf, again) != 0) {
+	fprintf(stderr, "round trip mismatch:\n%s%s", buf, again);
+	return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    static struct ais_t messages[MESSAGES];
+    char buf[AIS_ENCODE_MAX_LEN];
+    unsigned long print = 0, n, iterations = 1, failures = 0;
+    size_t sentences = 0, bytes = 0;
+    double best = 0;
+    int round, i;
+
+    for (i = 1; i < argc; i++) {
+	if (strcmp(argv[i], "--print") == 0 && i + 1 < argc)
+	    print = strtoul(argv[++i], NULL, 10);
+	else {
+	    fprintf(stderr, "usage: %s [--print N]\n", argv[0]);
+	    return 2;
+	}
+    }
+
+    launch();
+    if (print > 0) {
+	struct ais_t ais;
+
+	for (n = 0; n < print; n++) {
+	    generate(&ais, n);
+	    (void)encode(&ais, n, buf, &sentences);
+	    (void)fputs(buf, stdout);
+	}
+	return 0;
+    }
+
+    for (n = 0; n < MESSAGES; n++)
+	generate(&messages[n], n);
+
+    /* size a round, then keep the fastest of 5 */
+    for (round = -1; round < 5; round++) {
+	double start = now(), elapsed;
+
+	sentences = bytes = 0;
+	for (i = 0; i < (int)iterations; i++)
+	    for (n = 0; n < MESSAGES; n++)
+		bytes += encode(&messages[n], n, buf, &sentences);
+	elapsed = now() - start;
+	if (round < 0) {
+	    if (elapsed < 0.05)
+		iterations = (unsigned long)(iterations * 0.06 / elapsed) + 1;
+	} else if (best == 0 || elapsed < best)
+	    best = elapsed;
+    }
+    printf("%lu messages: %.1f ns/message, %.0f messages/s, "
+	   "%.0f sentences/s, %.0f MB/s\n",
+	   iterations * MESSAGES, best * 1e9 / (iterations * MESSAGES),
+	   iterations * MESSAGES / best, sentences / best, bytes / best / 1e6);
+
+    for (n = 0; n < MESSAGES; n++)
+	failures += !round_trip(&messages[n], n);
+    printf("round trip: %d messages, %lu mismatches\n", MESSAGES, failures);
+    return failures > 0;
+}
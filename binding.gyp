@@ -1,18 +1,38 @@
 {
-  "targets": [  
-    {                           
-      "target_name": "aisdecoder",
-      "sources": [ 
-        "src/addon.cpp", 
-        "src/aisdecoder.cpp", 
+  "targets": [
+    {
+      # The decoder core and its C wrapper, also built standalone as
+      # libaisdecoder by `make lib`
+      "target_name": "aisdecoder_core",
+      "type": "static_library",
+      "sources": [
+        "src/aisdecoder.cpp",
         "src/driver_ais.c",
-        "src/bits.c", 
-        "src/hex.c", 
+        "src/ais_layout.c",
+        "src/bits.c",
+        "src/hex.c",
         "src/aivdm_decode.c",
+        "src/aivdm_simd.c",
+        "src/ais_vessel.c",
         "src/gpsd.c",
         "src/strl.c",
       ],
-      "defines": [ "<@(strldefines)" ]
+      "defines": [ "<@(strldefines)", "GPSD_MAX_LOG_LEVEL=LOG_ERROR" ],
+      "conditions": [
+        # linked into the addon, a shared object
+        ['OS!="win"', {"cflags": [ "-fPIC" ]}]
+      ],
+      "direct_dependent_settings": {
+        "include_dirs": [ "src" ],
+        "defines": [ "<@(strldefines)", "GPSD_MAX_LOG_LEVEL=LOG_ERROR" ]
+      }
+    },
+    {
+      "target_name": "aisdecoder",
+      "sources": [
+        "src/addon.cpp",
+      ],
+      "dependencies": [ "aisdecoder_core" ]
     }
   ],
   "variables": {
@@ -0,0 +1,163 @@
+var stream = require('stream');
+var util = require('util');
+var aisdecoder = require('./build/Release/aisdecoder.node');
+var AisDecoder = aisdecoder.AisDecoder;
+
+/*
+ * decodeAsync(sentences, [callback])
+ *
+ * Without a callback, returns a Promise for the array of decoded messages
+ * (where Promise is available).
+ */
+var nativeDecodeAsync = AisDecoder.prototype.decodeAsync;
+AisDecoder.prototype.decodeAsync = function(sentences, callback) {
+  if (typeof callback === 'function' || typeof Promise !== 'function') {
+    return nativeDecodeAsync.call(this, sentences, callback);
+  }
+  var self = this;
+  return new Promise(function(resolve, reject) {
+    nativeDecodeAsync.call(self, sentences, function(err, results) {
+      if (err) reject(err);
+      else resolve(results);
+    });
+  });
+};
+
+/*
+ * PositionRecords(capacity)
+ *
+ * Storage for up to capacity compact position records, as filled by
+ * decodePositions(): struct ais_position_t in src/ais_position.h, 32
+ * bytes each. The records share one ArrayBuffer, viewed as bytes, int8,
+ * uint16, int32 and uint32 typed arrays; the accessors below read one
+ * member of record i through them and convert it like decode() does.
+ */
+function PositionRecords(capacity) {
+  if (!(this instanceof PositionRecords)) return new PositionRecords(capacity);
+  this.capacity = capacity;
+  this.length = 0;
+  this.buffer = new ArrayBuffer(capacity * PositionRecords.SIZE);
+  this.bytes = new Uint8Array(this.buffer);
+  this.int8 = new Int8Array(this.buffer);
+  this.uint16 = new Uint16Array(this.buffer);
+  this.int32 = new Int32Array(this.buffer);
+  this.uint32 = new Uint32Array(this.buffer);
+}
+
+PositionRecords.SIZE = 32;
+PositionRecords.ACCURACY = 0x01;
+PositionRecords.RAIM = 0x02;
+PositionRecords.ASSIGNED = 0x04;
+PositionRecords.CS = 0x08;
+PositionRecords.GNSS = 0x10;
+
+PositionRecords.prototype.mmsi = function(i) { return this.uint32[i * 8]; };
+PositionRecords.prototype.lat = function(i) { return this.int32[i * 8 + 1] / 600000; };
+PositionRecords.prototype.lon = function(i) { return this.int32[i * 8 + 2] / 600000; };
+PositionRecords.prototype.speed = function(i) { return this.uint16[i * 16 + 6] / 10; };
+PositionRecords.prototype.course = function(i) { return this.uint16[i * 16 + 7] / 10; };
+PositionRecords.prototype.heading = function(i) { return this.uint16[i * 16 + 8]; };
+PositionRecords.prototype.type = function(i) { return this.bytes[i * 32 + 18]; };
+PositionRecords.prototype.status = function(i) { return this.bytes[i * 32 + 19]; };
+PositionRecords.prototype.second = function(i) { return this.bytes[i * 32 + 20]; };
+PositionRecords.prototype.turn = function(i) { return this.int8[i * 32 + 21]; };
+PositionRecords.prototype.flags = function(i) { return this.bytes[i * 32 + 22]; };
+PositionRecords.prototype.repeat = function(i) { return this.bytes[i * 32 + 23]; };
+PositionRecords.prototype.radio = function(i) { return this.uint32[i * 8 + 6]; };
+
+/*
+ * decodePositions(sentences, records)
+ *
+ * Appends the position reports in sentences to records, a
+ * PositionRecords; decoding stops when it is full. Returns the number of
+ * records added.
+ */
+var nativeDecodePositions = AisDecoder.prototype.decodePositions;
+AisDecoder.prototype.decodePositions = function(sentences, records) {
+  if (!(records instanceof PositionRecords)) {
+    return nativeDecodePositions.apply(this, arguments);
+  }
+  var n = nativeDecodePositions.call(this, sentences, records.bytes, records.length);
+  records.length += n;
+  return n;
+};
+
+aisdecoder.PositionRecords = PositionRecords;
+
+/*
+ * PositionColumns(capacity)
+ *
+ * Columnar storage for up to capacity position records, as filled by
+ * decodeColumns(): one typed array per record member, in the units of
+ * struct ais_position_t (lat/lon in 1/10000 minutes, speed in deciknots,
+ * course in decidegrees). Columns can be deleted before decoding to skip
+ * them.
+ */
+function PositionColumns(capacity) {
+  if (!(this instanceof PositionColumns)) return new PositionColumns(capacity);
+  this.capacity = capacity;
+  this.length = 0;
+  this.mmsi = new Uint32Array(capacity);
+  this.lat = new Int32Array(capacity);
+  this.lon = new Int32Array(capacity);
+  this.speed = new Uint16Array(capacity);
+  this.course = new Uint16Array(capacity);
+  this.heading = new Uint16Array(capacity);
+  this.type = new Uint8Array(capacity);
+  this.status = new Uint8Array(capacity);
+  this.second = new Uint8Array(capacity);
+  this.turn = new Int8Array(capacity);
+  this.flags = new Uint8Array(capacity);
+}
+
+/*
+ * decodeColumns(sentences, columns)
+ *
+ * Appends the position reports in sentences to columns, a
+ * PositionColumns; decoding stops when it is full. Returns the number of
+ * records added.
+ */
+var nativeDecodeColumns = AisDecoder.prototype.decodeColumns;
+AisDecoder.prototype.decodeColumns = function(sentences, columns) {
+  if (!(columns instanceof PositionColumns)) {
+    return nativeDecodeColumns.apply(this, arguments);
+  }
+  var n = nativeDecodeColumns.call(this, sentences, columns, columns.length);
+  columns.length += n;
+  return n;
+};
+
+aisdecoder.PositionColumns = PositionColumns;
+
+/*
+ * AisDecodeStream([options])
+ *
+ * Transform stream taking raw NMEA bytes, in chunks of any size, and
+ * emitting decoded message objects. Sentence framing is done natively by
+ * decodeChunk(). options.decoder may supply the AisDecoder to use;
+ * otherwise one is created with options (e.g. options.fields).
+ */
+function AisDecodeStream(options) {
+  if (!(this instanceof AisDecodeStream)) return new AisDecodeStream(options);
+  options = options || {};
+  stream.Transform.call(this, { objectMode: true });
+  this.decoder = options.decoder || new AisDecoder(options);
+}
+util.inherits(AisDecodeStream, stream.Transform);
+
+AisDecodeStream.prototype._transform = function(chunk, encoding, callback) {
+  var results = this.decoder.decodeChunk(chunk);
+  for (var i = 0; i < results.length; i++) this.push(results[i]);
+  callback();
+};
+
+AisDecodeStream.prototype._flush = function(callback) {
+  // Terminate a final sentence lacking a line ending
+  var results = this.decoder.decodeChunk('\n');
+  for (var i = 0; i < results.length; i++) this.push(results[i]);
+  callback();
+};
+
+aisdecoder.AisDecodeStream = AisDecodeStream;
+
+module.exports = aisdecoder;
@@ -1,11 +1,24 @@
 #include <node.h>
+#include <node_buffer.h>
 #include <v8.h>
 
 
 #include "aisdecoder.h"
 
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <deque>
+
 using namespace v8;
 
+// Field mask bits for the message header, above any layout's fields
+static const uint32_t FIELD_REPEAT = 1u << 30;
+static const uint32_t FIELD_MMSI = 1u << 31;
+static const uint32_t ALL_FIELDS = 0xffffffff;
+
 static const char *ais_typestring(unsigned int type)
 {
   switch (type) {
@@ -35,27 +48,75 @@ static const char *ais_typestring(unsigned int type)
   }
 }
 
-Handle<Object> convertToJS(ais_t *ais)
+/*
+  Property names and string values set by convertToJS(). They are
+  created once, as internalized symbols, by initKeys() rather than for
+  every message.
+*/
+#define PROPERTY_KEYS(X) \
+  X(type) X(mmsi) X(repeat) X(status) X(lon) X(lat) X(course) X(heading) \
+  X(accuracy) X(second) X(maneuver) X(raim) X(radio) X(speed) X(turn) X(epfd) \
+  X(imo) X(callsign) X(shipname) X(shiptype) X(destination) X(ais_version) \
+  X(to_bow) X(to_stern) X(to_port) X(to_starboard) X(draught) X(dte) \
+  X(regional) X(cs) X(display) X(dsc) X(band) X(msg22) X(assigned) X(gnss) \
+  X(tagblock) X(time) X(source) X(group) X(sentence) X(count) X(id) \
+  X(updated) X(eta)
+#define PROPERTY_VALUES(X) \
+  X(nan) X(fast) X(fastleft) X(fastright)
+
+#define DECLARE_KEY(name) static Persistent<String> key_##name;
+PROPERTY_KEYS(DECLARE_KEY)
+#undef DECLARE_KEY
+#define DECLARE_VALUE(name) static Persistent<String> value_##name;
+PROPERTY_VALUES(DECLARE_VALUE)
+#undef DECLARE_VALUE
+// ais_typestring() of each message type
+static Persistent<String> typenames[64];
+
+#define KEY(name) key_##name
+#define VALUE(name) value_##name
+#define TYPENAME(type) typenames[(type) & 63]
+
+static void initKeys()
 {
+#define INIT_KEY(name) key_##name = Persistent<String>::New(String::NewSymbol(#name));
+  PROPERTY_KEYS(INIT_KEY)
+#undef INIT_KEY
+#define INIT_VALUE(name) value_##name = Persistent<String>::New(String::NewSymbol(#name));
+  PROPERTY_VALUES(INIT_VALUE)
+#undef INIT_VALUE
+  for (unsigned int type = 0; type < 64; type++) {
+    typenames[type] = Persistent<String>::New(String::NewSymbol(ais_typestring(type)));
+  }
+}
+
+/*
+  Converts a decoded message to a JS object. fields is the mask of
+  ais_layout() fields to convert, plus FIELD_REPEAT and FIELD_MMSI;
+  properties which don't come from a layout field are always set.
+*/
+Handle<Object> convertToJS(ais_t *ais, uint32_t fields = ALL_FIELDS)
+{
+#define WANT(group, member) ((fields & AIS_FIELD_BIT(group, member)) != 0)
   // Create AIS object
   Handle<Object> aisobj = Object::New();
-  aisobj->Set(String::New("type"), String::New(ais_typestring(ais->type)));
-  aisobj->Set(String::New("mmsi"), Number::New(ais->mmsi));
-  aisobj->Set(String::New("repeat"), Number::New(ais->repeat));
+  aisobj->Set(KEY(type), TYPENAME(ais->type));
+  if (fields & FIELD_MMSI) aisobj->Set(KEY(mmsi), Number::New(ais->mmsi));
+  if (fields & FIELD_REPEAT) aisobj->Set(KEY(repeat), Number::New(ais->repeat));
   switch (ais->type) {
   case 1:			/* Position Report */
   case 2:
   case 3:
-    aisobj->Set(String::New("status"), Number::New(ais->type1.status));
-    aisobj->Set(String::New("lon"), Number::New(ais->type1.lon / AIS_LATLON_DIV));
-    aisobj->Set(String::New("lat"), Number::New(ais->type1.lat / AIS_LATLON_DIV));
-    aisobj->Set(String::New("course"), Number::New(ais->type1.course / 10.0));
-    aisobj->Set(String::New("heading"), Number::New(ais->type1.heading));
-    aisobj->Set(String::New("accuracy"), Boolean::New(ais->type1.accuracy));
-    aisobj->Set(String::New("second"), Number::New(ais->type1.second));
-    aisobj->Set(String::New("maneuver"), Number::New(ais->type1.maneuver));
-    aisobj->Set(String::New("raim"), Boolean::New(ais->type1.raim));
-    aisobj->Set(String::New("radio"), Number::New(ais->type1.radio));
+    if (WANT(type1, status)) aisobj->Set(KEY(status), Number::New(ais->type1.status));
+    if (WANT(type1, lon)) aisobj->Set(KEY(lon), Number::New(ais->type1.lon / AIS_LATLON_DIV));
+    if (WANT(type1, lat)) aisobj->Set(KEY(lat), Number::New(ais->type1.lat / AIS_LATLON_DIV));
+    if (WANT(type1, course)) aisobj->Set(KEY(course), Number::New(ais->type1.course / 10.0));
+    if (WANT(type1, heading)) aisobj->Set(KEY(heading), Number::New(ais->type1.heading));
+    if (WANT(type1, accuracy)) aisobj->Set(KEY(accuracy), Boolean::New(ais->type1.accuracy));
+    if (WANT(type1, second)) aisobj->Set(KEY(second), Number::New(ais->type1.second));
+    if (WANT(type1, maneuver)) aisobj->Set(KEY(maneuver), Number::New(ais->type1.maneuver));
+    if (WANT(type1, raim)) aisobj->Set(KEY(raim), Boolean::New(ais->type1.raim));
+    if (WANT(type1, radio)) aisobj->Set(KEY(radio), Number::New(ais->type1.radio));
 
     /*
       \"status_text\":\"%s\","
@@ -66,51 +127,51 @@ Handle<Object> convertToJS(ais_t *ais)
      * Express speed as nan if not available,
      * "fast" for fast movers.
      */
-    {
+    if (WANT(type1, speed)) {
       Handle<Value> speedval;
       switch (ais->type1.speed) {
       case AIS_SPEED_NOT_AVAILABLE:
-        speedval = String::New("nan");
+        speedval = VALUE(nan);
         break;
       case AIS_SPEED_FAST_MOVER:
-        speedval = String::New("fast");
+        speedval = VALUE(fast);
         break;
       default:
         speedval = Number::New(ais->type1.speed / 10.0);
         break;
       }
-      aisobj->Set(String::New("speed"), speedval);
+      aisobj->Set(KEY(speed), speedval);
     }
 
     /*
      * Express turn as nan if not available,
      * "fastleft"/"fastright" for fast turns.
      */
-    {
+    if (WANT(type1, turn)) {
       Handle<Value> turnval;
       switch (ais->type1.turn) {
       case -128:
-        turnval = String::New("nan");
+        turnval = VALUE(nan);
         break;
       case -127:
-        turnval = String::New("fastleft");
+        turnval = VALUE(fastleft);
         break;
       case 127:
-        turnval = String::New("fastright");
+        turnval = VALUE(fastright);
         break;
       default:
         double rot1 = ais->type1.turn / 4.733;
         turnval = Number::New(rot1 * rot1);
       }
-      aisobj->Set(String::New("turn"), turnval);
+      aisobj->Set(KEY(turn), turnval);
     }
 
     break;
   case 4:			/* Base Station Report */
   case 11:			/* UTC/Date Response */
     /* some fields have been merged to an ISO8601 date */
-    aisobj->Set(String::New("lon"), Number::New(ais->type4.lon / AIS_LATLON_DIV));
-    aisobj->Set(String::New("lat"), Number::New(ais->type4.lat / AIS_LATLON_DIV));
+    if (WANT(type4, lon)) aisobj->Set(KEY(lon), Number::New(ais->type4.lon / AIS_LATLON_DIV));
+    if (WANT(type4, lat)) aisobj->Set(KEY(lat), Number::New(ais->type4.lat / AIS_LATLON_DIV));
     /*
       aisobj->Set(String::New("timestamp"), );
       ais->type4.year,
@@ -120,10 +181,10 @@ Handle<Object> convertToJS(ais_t *ais)
       ais->type4.minute,
       ais->type4.second,
     */
-    aisobj->Set(String::New("accuracy"), Boolean::New(ais->type4.accuracy));
-    aisobj->Set(String::New("raim"), Boolean::New(ais->type4.raim));
-    aisobj->Set(String::New("radio"), Number::New(ais->type4.radio));
-    aisobj->Set(String::New("epfd"), Number::New(ais->type4.epfd));
+    if (WANT(type4, accuracy)) aisobj->Set(KEY(accuracy), Boolean::New(ais->type4.accuracy));
+    if (WANT(type4, raim)) aisobj->Set(KEY(raim), Boolean::New(ais->type4.raim));
+    if (WANT(type4, radio)) aisobj->Set(KEY(radio), Number::New(ais->type4.radio));
+    if (WANT(type4, epfd)) aisobj->Set(KEY(epfd), Number::New(ais->type4.epfd));
     /*
       \"epfd_text\":\"%s\","
       EPFD_DISPLAY(ais->type4.epfd),
@@ -131,20 +192,20 @@ Handle<Object> convertToJS(ais_t *ais)
     break;
   case 5:			/* Ship static and voyage related data */
     /* some fields have been merged to an ISO8601 partial date */
-    aisobj->Set(String::New("imo"), Number::New(ais->type5.imo));
-    aisobj->Set(String::New("callsign"), String::New(ais->type5.callsign));
-    aisobj->Set(String::New("shipname"), String::New(ais->type5.shipname));
-    aisobj->Set(String::New("shiptype"), Number::New(ais->type5.shiptype));
-    aisobj->Set(String::New("destination"), String::New(ais->type5.destination));
-
-    aisobj->Set(String::New("ais_version"), Number::New(ais->type5.ais_version));
-    aisobj->Set(String::New("to_bow"), Number::New(ais->type5.to_bow));
-    aisobj->Set(String::New("to_stern"), Number::New(ais->type5.to_stern));
-    aisobj->Set(String::New("to_port"), Number::New(ais->type5.to_port));
-    aisobj->Set(String::New("to_starboard"), Number::New(ais->type5.to_starboard));
-    aisobj->Set(String::New("epfd"), Number::New(ais->type5.epfd));
-    aisobj->Set(String::New("draught"), Number::New(ais->type5.draught / 10.0));
-    aisobj->Set(String::New("dte"), Number::New(ais->type5.dte));
+    if (WANT(type5, imo)) aisobj->Set(KEY(imo), Number::New(ais->type5.imo));
+    if (WANT(type5, callsign)) aisobj->Set(KEY(callsign), String::New(ais->type5.callsign));
+    if (WANT(type5, shipname)) aisobj->Set(KEY(shipname), String::New(ais->type5.shipname));
+    if (WANT(type5, shiptype)) aisobj->Set(KEY(shiptype), Number::New(ais->type5.shiptype));
+    if (WANT(type5, destination)) aisobj->Set(KEY(destination), String::New(ais->type5.destination));
+
+    if (WANT(type5, ais_version)) aisobj->Set(KEY(ais_version), Number::New(ais->type5.ais_version));
+    if (WANT(type5, to_bow)) aisobj->Set(KEY(to_bow), Number::New(ais->type5.to_bow));
+    if (WANT(type5, to_stern)) aisobj->Set(KEY(to_stern), Number::New(ais->type5.to_stern));
+    if (WANT(type5, to_port)) aisobj->Set(KEY(to_port), Number::New(ais->type5.to_port));
+    if (WANT(type5, to_starboard)) aisobj->Set(KEY(to_starboard), Number::New(ais->type5.to_starboard));
+    if (WANT(type5, epfd)) aisobj->Set(KEY(epfd), Number::New(ais->type5.epfd));
+    if (WANT(type5, draught)) aisobj->Set(KEY(draught), Number::New(ais->type5.draught / 10.0));
+    aisobj->Set(KEY(dte), Number::New(ais->type5.dte));
 
     /*
       \"shiptype_text\":\"%s\","
@@ -159,48 +220,48 @@ Handle<Object> convertToJS(ais_t *ais)
     */
     break;
     case 18:
-    aisobj->Set(String::New("lon"), Number::New(ais->type18.lon / AIS_LATLON_DIV));
-    aisobj->Set(String::New("lat"), Number::New(ais->type18.lat / AIS_LATLON_DIV));
-    aisobj->Set(String::New("course"), Number::New(ais->type18.course / 10.0));
-    if (ais->type18.heading != 511) {
-      aisobj->Set(String::New("heading"), Number::New(ais->type18.heading));
-    }
-    aisobj->Set(String::New("speed"), Number::New(ais->type18.speed / 10.0));
-    aisobj->Set(String::New("accuracy"), Boolean::New(ais->type18.accuracy));
+    if (WANT(type18, lon)) aisobj->Set(KEY(lon), Number::New(ais->type18.lon / AIS_LATLON_DIV));
+    if (WANT(type18, lat)) aisobj->Set(KEY(lat), Number::New(ais->type18.lat / AIS_LATLON_DIV));
+    if (WANT(type18, course)) aisobj->Set(KEY(course), Number::New(ais->type18.course / 10.0));
+    if (WANT(type18, heading) && ais->type18.heading != 511) {
+      aisobj->Set(KEY(heading), Number::New(ais->type18.heading));
+    }
+    if (WANT(type18, speed)) aisobj->Set(KEY(speed), Number::New(ais->type18.speed / 10.0));
+    if (WANT(type18, accuracy)) aisobj->Set(KEY(accuracy), Boolean::New(ais->type18.accuracy));
     //    aisobj->Set(String::New("reserved"), Number::New(ais->type18.reserved));
-    aisobj->Set(String::New("regional"), Number::New(ais->type18.regional));
-    aisobj->Set(String::New("cs"), Boolean::New(ais->type18.cs));
-    aisobj->Set(String::New("display"), Boolean::New(ais->type18.display));
-    aisobj->Set(String::New("dsc"), Boolean::New(ais->type18.dsc));
-    aisobj->Set(String::New("band"), Boolean::New(ais->type18.band));
-    aisobj->Set(String::New("msg22"), Boolean::New(ais->type18.msg22));
-    aisobj->Set(String::New("raim"), Boolean::New(ais->type18.raim));
-    aisobj->Set(String::New("radio"), Number::New(ais->type18.radio));
-    aisobj->Set(String::New("assigned"), Number::New(ais->type18.assigned));
-    aisobj->Set(String::New("second"), Number::New(ais->type18.second));
+    if (WANT(type18, regional)) aisobj->Set(KEY(regional), Number::New(ais->type18.regional));
+    if (WANT(type18, cs)) aisobj->Set(KEY(cs), Boolean::New(ais->type18.cs));
+    if (WANT(type18, display)) aisobj->Set(KEY(display), Boolean::New(ais->type18.display));
+    if (WANT(type18, dsc)) aisobj->Set(KEY(dsc), Boolean::New(ais->type18.dsc));
+    if (WANT(type18, band)) aisobj->Set(KEY(band), Boolean::New(ais->type18.band));
+    if (WANT(type18, msg22)) aisobj->Set(KEY(msg22), Boolean::New(ais->type18.msg22));
+    if (WANT(type18, raim)) aisobj->Set(KEY(raim), Boolean::New(ais->type18.raim));
+    if (WANT(type18, radio)) aisobj->Set(KEY(radio), Number::New(ais->type18.radio));
+    if (WANT(type18, assigned)) aisobj->Set(KEY(assigned), Number::New(ais->type18.assigned));
+    if (WANT(type18, second)) aisobj->Set(KEY(second), Number::New(ais->type18.second));
     break;
     case 19:
-    aisobj->Set(String::New("lon"), Number::New(ais->type19.lon / AIS_LATLON_DIV));
-    aisobj->Set(String::New("lat"), Number::New(ais->type19.lat / AIS_LATLON_DIV));
-    aisobj->Set(String::New("course"), Number::New(ais->type19.course / 10.0));
-    if (ais->type19.heading != 511) {
-      aisobj->Set(String::New("heading"), Number::New(ais->type19.heading));
-    }
-    aisobj->Set(String::New("speed"), Number::New(ais->type19.speed / 10.0));
-    aisobj->Set(String::New("accuracy"), Boolean::New(ais->type19.accuracy));
+    if (WANT(type19, lon)) aisobj->Set(KEY(lon), Number::New(ais->type19.lon / AIS_LATLON_DIV));
+    if (WANT(type19, lat)) aisobj->Set(KEY(lat), Number::New(ais->type19.lat / AIS_LATLON_DIV));
+    if (WANT(type19, course)) aisobj->Set(KEY(course), Number::New(ais->type19.course / 10.0));
+    if (WANT(type19, heading) && ais->type19.heading != 511) {
+      aisobj->Set(KEY(heading), Number::New(ais->type19.heading));
+    }
+    if (WANT(type19, speed)) aisobj->Set(KEY(speed), Number::New(ais->type19.speed / 10.0));
+    if (WANT(type19, accuracy)) aisobj->Set(KEY(accuracy), Boolean::New(ais->type19.accuracy));
     //    aisobj->Set(String::New("reserved"), Number::New(ais->type19.reserved));
-    aisobj->Set(String::New("regional"), Number::New(ais->type19.regional));
-    aisobj->Set(String::New("second"), Number::New(ais->type19.second));
-    aisobj->Set(String::New("shipname"), String::New(ais->type19.shipname));
-    aisobj->Set(String::New("shiptype"), Number::New(ais->type19.shiptype));
-    aisobj->Set(String::New("to_bow"), Number::New(ais->type19.to_bow));
-    aisobj->Set(String::New("to_stern"), Number::New(ais->type19.to_stern));
-    aisobj->Set(String::New("to_port"), Number::New(ais->type19.to_port));
-    aisobj->Set(String::New("to_starboard"), Number::New(ais->type19.to_starboard));
-    aisobj->Set(String::New("epfd"), Number::New(ais->type19.epfd));
-    aisobj->Set(String::New("raim"), Boolean::New(ais->type19.raim));
-    aisobj->Set(String::New("dte"), Number::New(ais->type19.dte));
-    aisobj->Set(String::New("assigned"), Boolean::New(ais->type19.assigned));
+    if (WANT(type19, regional)) aisobj->Set(KEY(regional), Number::New(ais->type19.regional));
+    if (WANT(type19, second)) aisobj->Set(KEY(second), Number::New(ais->type19.second));
+    if (WANT(type19, shipname)) aisobj->Set(KEY(shipname), String::New(ais->type19.shipname));
+    if (WANT(type19, shiptype)) aisobj->Set(KEY(shiptype), Number::New(ais->type19.shiptype));
+    if (WANT(type19, to_bow)) aisobj->Set(KEY(to_bow), Number::New(ais->type19.to_bow));
+    if (WANT(type19, to_stern)) aisobj->Set(KEY(to_stern), Number::New(ais->type19.to_stern));
+    if (WANT(type19, to_port)) aisobj->Set(KEY(to_port), Number::New(ais->type19.to_port));
+    if (WANT(type19, to_starboard)) aisobj->Set(KEY(to_starboard), Number::New(ais->type19.to_starboard));
+    if (WANT(type19, epfd)) aisobj->Set(KEY(epfd), Number::New(ais->type19.epfd));
+    if (WANT(type19, raim)) aisobj->Set(KEY(raim), Boolean::New(ais->type19.raim));
+    if (WANT(type19, dte)) aisobj->Set(KEY(dte), Number::New(ais->type19.dte));
+    if (WANT(type19, assigned)) aisobj->Set(KEY(assigned), Boolean::New(ais->type19.assigned));
 
     /*\"shiptype_text\":\"%s\","
 \"epfd_text\":\"%s\","
@@ -209,14 +270,14 @@ Handle<Object> convertToJS(ais_t *ais)
     */
     break;
   case 27:
-    aisobj->Set(String::New("lon"), Number::New(ais->type27.lon / AIS_LONGRANGE_LATLON_DIV));
-    aisobj->Set(String::New("lat"), Number::New(ais->type27.lat / AIS_LONGRANGE_LATLON_DIV));
-    aisobj->Set(String::New("course"), Number::New(ais->type27.course));
-    aisobj->Set(String::New("speed"), Number::New(ais->type27.speed));
-    aisobj->Set(String::New("accuracy"), Boolean::New(ais->type27.accuracy));
-    aisobj->Set(String::New("raim"), Boolean::New(ais->type27.raim));
-    aisobj->Set(String::New("gnss"), Boolean::New(ais->type27.gnss));
-    aisobj->Set(String::New("status"), Number::New(ais->type27.status));
+    if (WANT(type27, lon)) aisobj->Set(KEY(lon), Number::New(ais->type27.lon / AIS_LONGRANGE_LATLON_DIV));
+    if (WANT(type27, lat)) aisobj->Set(KEY(lat), Number::New(ais->type27.lat / AIS_LONGRANGE_LATLON_DIV));
+    if (WANT(type27, course)) aisobj->Set(KEY(course), Number::New(ais->type27.course));
+    if (WANT(type27, speed)) aisobj->Set(KEY(speed), Number::New(ais->type27.speed));
+    if (WANT(type27, accuracy)) aisobj->Set(KEY(accuracy), Boolean::New(ais->type27.accuracy));
+    if (WANT(type27, raim)) aisobj->Set(KEY(raim), Boolean::New(ais->type27.raim));
+    if (WANT(type27, gnss)) aisobj->Set(KEY(gnss), Boolean::New(ais->type27.gnss));
+    if (WANT(type27, status)) aisobj->Set(KEY(status), Number::New(ais->type27.status));
     /*
 			   "\"status\":\"%s\","
 			   nav_legends[ais->type27.status],
@@ -227,6 +288,52 @@ Handle<Object> convertToJS(ais_t *ais)
   }
 
   return aisobj;
+#undef WANT
+}
+
+/*
+  Converts a vessel table record to a JS object, in the units of
+  convertToJS(). Position properties are set once a position report has
+  come in, and only if available; static ones once static data has.
+*/
+Handle<Object> convertVessel(const ais_vessel_t *vessel)
+{
+  const ais_position_t *pos = &vessel->position;
+  Handle<Object> obj = Object::New();
+  obj->Set(KEY(mmsi), Number::New(pos->mmsi));
+  obj->Set(KEY(updated), Number::New(static_cast<double>(vessel->updated)));
+  if (pos->type != 0) {
+    if (pos->lat != AIS_LAT_NOT_AVAILABLE && pos->lon != AIS_LON_NOT_AVAILABLE) {
+      obj->Set(KEY(lat), Number::New(pos->lat / AIS_LATLON_DIV));
+      obj->Set(KEY(lon), Number::New(pos->lon / AIS_LATLON_DIV));
+    }
+    if (pos->speed != AIS_SPEED_NOT_AVAILABLE) obj->Set(KEY(speed), Number::New(pos->speed / 10.0));
+    if (pos->course != AIS_COURSE_NOT_AVAILABLE) obj->Set(KEY(course), Number::New(pos->course / 10.0));
+    if (pos->heading != AIS_HEADING_NOT_AVAILABLE) obj->Set(KEY(heading), Number::New(pos->heading));
+    if (pos->status != AIS_POSITION_NO_STATUS) obj->Set(KEY(status), Number::New(pos->status));
+    if (pos->second != AIS_SEC_NOT_AVAILABLE) obj->Set(KEY(second), Number::New(pos->second));
+    obj->Set(KEY(accuracy), Boolean::New((pos->flags & AIS_POSITION_ACCURACY) != 0));
+  }
+  if (vessel->static_type != 0) {
+    if (vessel->imo != 0) obj->Set(KEY(imo), Number::New(vessel->imo));
+    if (vessel->callsign[0]) obj->Set(KEY(callsign), String::New(vessel->callsign));
+    if (vessel->shipname[0]) obj->Set(KEY(shipname), String::New(vessel->shipname));
+    obj->Set(KEY(shiptype), Number::New(vessel->shiptype));
+    obj->Set(KEY(to_bow), Number::New(vessel->to_bow));
+    obj->Set(KEY(to_stern), Number::New(vessel->to_stern));
+    obj->Set(KEY(to_port), Number::New(vessel->to_port));
+    obj->Set(KEY(to_starboard), Number::New(vessel->to_starboard));
+    if (vessel->epfd != 0) obj->Set(KEY(epfd), Number::New(vessel->epfd));
+  }
+  if (vessel->destination[0]) obj->Set(KEY(destination), String::New(vessel->destination));
+  if (vessel->draught != 0) obj->Set(KEY(draught), Number::New(vessel->draught / 10.0));
+  if (vessel->eta_month != AIS_MONTH_NOT_AVAILABLE) {
+    char eta[16];
+    snprintf(eta, sizeof(eta), "%02u-%02uT%02u:%02uZ", vessel->eta_month, vessel->eta_day,
+             vessel->eta_hour, vessel->eta_minute);
+    obj->Set(KEY(eta), String::New(eta));
+  }
+  return obj;
 }
 
 class AisDecoder : public node::ObjectWrap
@@ -240,6 +347,36 @@ public:
     // Prototype
     tpl->PrototypeTemplate()->Set(String::NewSymbol("decode"),
                                   FunctionTemplate::New(decode)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("decodeBatch"),
+                                  FunctionTemplate::New(decodeBatch)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("decodeAsync"),
+                                  FunctionTemplate::New(decodeAsync)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("decodeFile"),
+                                  FunctionTemplate::New(decodeFile)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("decodeChunk"),
+                                  FunctionTemplate::New(decodeChunk)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("decodePositions"),
+                                  FunctionTemplate::New(decodePositions)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("decodeColumns"),
+                                  FunctionTemplate::New(decodeColumns)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("setSource"),
+                                  FunctionTemplate::New(setSource)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("reassemblyStats"),
+                                  FunctionTemplate::New(reassemblyStats)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("checksumErrors"),
+                                  FunctionTemplate::New(checksumErrors)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("stats"),
+                                  FunctionTemplate::New(stats)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("resetStats"),
+                                  FunctionTemplate::New(resetStats)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("vessel"),
+                                  FunctionTemplate::New(vessel)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("vessels"),
+                                  FunctionTemplate::New(vessels)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("vesselUpdates"),
+                                  FunctionTemplate::New(vesselUpdates)->GetFunction());
+    tpl->PrototypeTemplate()->Set(String::NewSymbol("expireVessels"),
+                                  FunctionTemplate::New(expireVessels)->GetFunction());
 
     Persistent<Function> constructor = Persistent<Function>::New(tpl->GetFunction());
 
@@ -247,49 +384,1262 @@ public:
     exports->Set(String::NewSymbol("AisDecoder"), constructor);   
   }
 private:
+  /*!
+    A message decoded on the thread pool, with the tag block of the
+    sentence completing it. Its source is copied, as the sentence may be
+    gone by the time the message is converted on the main thread.
+  */
+  struct Decoded {
+    ais_t ais;
+    ais_tagblock_t tag;
+    std::string source;
+  };
+
+  /*!
+    State for one decodeAsync() call. The sentences are either copied from
+    JS strings, or read in place from a Buffer which is kept alive until
+    the work has completed. data/len point at newline-delimited input;
+    sentences holds the input when an array was passed.
+  */
+  struct DecodeBaton {
+    uv_work_t request;
+    AisDecoder *decoder;
+    Persistent<Function> callback;
+    Persistent<Object> buffer;
+    const char *data;
+    size_t len;
+    std::string text;
+    std::vector<std::string> sentences;
+    std::vector<Decoded> results;
+    unsigned int source;
+  };
+
+  /*!
+    State for one decodeFile() call. ais_decode_file() runs on the thread
+    pool, and the messages it delivers are gathered into batches of
+    FILE_BATCH, which are passed to the main thread through async. At most
+    FILE_BATCHES_PENDING batches wait there, so decoding can't run away
+    from ondata. handle has the decoder's settings and counts the file's
+    statistics, which are added to the decoder's at the end.
+  */
+  struct FileBaton {
+    uv_work_t request;
+    uv_async_t async;
+    AisDecoder *decoder;
+    Persistent<Function> ondata;
+    Persistent<Function> callback;
+    std::string path;
+    unsigned int threads;
+    ais_handle_t *handle;
+    // Guards batches
+    uv_mutex_t mutex;
+    uv_cond_t cond;
+    std::deque<std::vector<Decoded> *> batches;
+    std::vector<Decoded> *batch;
+    long count;
+    int error;
+  };
+  // Sentences decoded by decodeAsync() per lock of ais_handle
+  static const size_t ASYNC_SUB_BATCH = 64;
+  static const size_t FILE_BATCH = 4096;
+  static const size_t FILE_BATCHES_PENDING = 4;
+
   ais_handle_t *ais_handle;
+  // Per message type, the fields selected by the fields option
+  uint32_t fields[AIS_MESSAGE_TYPES];
+  // Guards ais_handle, which holds multipart reassembly state, against
+  // concurrent use from the main thread and the thread pool
+  uv_mutex_t mutex;
+  // decodeAsync() work is run one batch at a time, in call order
+  std::deque<DecodeBaton *> pending;
+  bool busy;
+  // Set by setSource() on the main thread; written under mutex
+  unsigned int source;
+  // The vessel table of options.vessels, updated through ais_handle and
+  // guarded by mutex like it; NULL if none
+  struct ais_vessel_table_t *vessel_table;
 
-  AisDecoder() {
+  AisDecoder() : busy(false), source(0), vessel_table(NULL) {
     this->ais_handle = ais_create_handle();
+    uv_mutex_init(&this->mutex);
+    for (unsigned int type = 0; type < AIS_MESSAGE_TYPES; type++) {
+      this->fields[type] = ALL_FIELDS;
+    }
   }
   ~AisDecoder() {
+    uv_mutex_destroy(&this->mutex);
     ais_destroy_handle(this->ais_handle);
+    ais_vessel_table_destroy(this->vessel_table);
   }
 
+  /*!
+    new AisDecoder([options])
+
+    options.fields selects the properties to decode, either as an array
+    of property names for all message types, or as an object mapping
+    message types to such arrays. Fields which aren't selected are
+    neither extracted from the message nor set on the decoded object.
+    This applies to "mmsi", "repeat" and the fields listed in
+    ais_layout.h; other properties are always set. Other names throw a
+    TypeError.
+
+    options.types is an array of the message types to decode. Sentences
+    of other types are rejected right after reading their type.
+
+    options.fragmentWindow and options.fragmentTimeout set when incomplete
+    multipart messages are given up: after that many further sentences
+    from their source (8 by default), or that many milliseconds after
+    their first fragment (no timeout by default). 0 disables either.
+
+    options.verifyChecksum, if true, rejects sentences without a correct
+    *hh checksum; checksumErrors() counts them.
+
+    options.vessels, a number of vessels, keeps a table of the last known
+    state of up to that many vessels, merged from every message decoded;
+    see vessel() and vessels().
+  */
   static Handle<Value> New(const Arguments& args) {
     HandleScope scope;
     
     AisDecoder *decoder = new AisDecoder();
     decoder->Wrap(args.This());
+
+    if (args[0]->IsObject()) {
+      Handle<Value> fields = args[0]->ToObject()->Get(String::NewSymbol("fields"));
+      std::string unknown;
+      if (!fields->IsUndefined() && !decoder->selectFields(fields, &unknown)) {
+        if (!unknown.empty()) {
+          return ThrowException(Exception::TypeError(String::New(("unknown field " + unknown).c_str())));
+        }
+        return ThrowException(Exception::TypeError(
+          String::New("fields must be an array of names, or an object of such arrays by message type")));
+      }
+      Handle<Value> types = args[0]->ToObject()->Get(String::NewSymbol("types"));
+      if (!types->IsUndefined()) {
+        if (!types->IsArray()) {
+          return ThrowException(Exception::TypeError(String::New("types must be an array of message types")));
+        }
+        decoder->selectTypes(Handle<Array>::Cast(types));
+      }
+      Handle<Value> window = args[0]->ToObject()->Get(String::NewSymbol("fragmentWindow"));
+      Handle<Value> timeout = args[0]->ToObject()->Get(String::NewSymbol("fragmentTimeout"));
+      if ((!window->IsUndefined() && !window->IsNumber()) ||
+          (!timeout->IsUndefined() && !timeout->IsNumber())) {
+        return ThrowException(Exception::TypeError(
+          String::New("fragmentWindow and fragmentTimeout must be numbers")));
+      }
+      ais_set_reassembly_limits(decoder->ais_handle,
+                                window->IsUndefined() ? AIS_DEFAULT_MAX_SENTENCES
+                                                      : window->Uint32Value(),
+                                timeout->IsUndefined() ? 0 : timeout->Uint32Value());
+      Handle<Value> verify = args[0]->ToObject()->Get(String::NewSymbol("verifyChecksum"));
+      ais_set_verify_checksum(decoder->ais_handle, verify->BooleanValue());
+      Handle<Value> capacity = args[0]->ToObject()->Get(String::NewSymbol("vessels"));
+      if (!capacity->IsUndefined()) {
+        if (capacity->IsNumber()) decoder->vessel_table = ais_vessel_table_create(capacity->Uint32Value());
+        if (!decoder->vessel_table) {
+          return ThrowException(Exception::RangeError(
+            String::New("vessels must be a number of vessels, from 1 to 268435456")));
+        }
+        ais_set_vessel_table(decoder->ais_handle, decoder->vessel_table);
+      }
+    }
     
     return args.This();
   }
 
+  // The mask of the fields of type in names; sets matched[i] for each name which is one
+  static uint32_t fieldMask(unsigned int type, Handle<Array> names, std::vector<bool> *matched) {
+    const struct ais_layout_t *layout = ais_layout(type);
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < names->Length(); i++) {
+      String::AsciiValue name(names->Get(i));
+      uint32_t bit = 0;
+      if (strcmp(*name, "mmsi") == 0) bit = FIELD_MMSI;
+      else if (strcmp(*name, "repeat") == 0) bit = FIELD_REPEAT;
+      else if (layout) {
+        for (size_t f = 0; f < layout->nfields; f++) {
+          if (strcmp(*name, layout->fields[f].name) == 0) bit = 1u << f;
+        }
+      }
+      if (bit) (*matched)[i] = true;
+      mask |= bit;
+    }
+    return mask;
+  }
+
+  static bool allStrings(Handle<Array> names) {
+    for (uint32_t i = 0; i < names->Length(); i++) {
+      if (!names->Get(i)->IsString()) return false;
+    }
+    return true;
+  }
+
+  // Sets *unknown to the first name not matched, if any
+  static bool allMatched(Handle<Array> names, const std::vector<bool> &matched, std::string *unknown) {
+    for (uint32_t i = 0; i < names->Length(); i++) {
+      if (!matched[i]) {
+        *unknown = *String::AsciiValue(names->Get(i));
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void setFields(unsigned int type, uint32_t mask) {
+    this->fields[type] = mask;
+    ais_select_fields(this->ais_handle, type, mask);
+  }
+
+  /*
+    Applies options.fields. Each name must be a field of its message
+    type, or with the array form of any type; if not, *unknown is set to
+    it and nothing is selected.
+  */
+  bool selectFields(Handle<Value> value, std::string *unknown) {
+    uint32_t masks[AIS_MESSAGE_TYPES];
+    bool given[AIS_MESSAGE_TYPES] = {false};
+    if (value->IsArray()) {
+      Handle<Array> names = Handle<Array>::Cast(value);
+      if (!allStrings(names)) return false;
+      std::vector<bool> matched(names->Length());
+      for (unsigned int type = 0; type < AIS_MESSAGE_TYPES; type++) {
+        if (ais_layout(type)) {
+          masks[type] = fieldMask(type, names, &matched);
+          given[type] = true;
+        }
+      }
+      if (!allMatched(names, matched, unknown)) return false;
+    } else {
+      if (!value->IsObject()) return false;
+      Handle<Object> bytype = value->ToObject();
+      Local<Array> types = bytype->GetOwnPropertyNames();
+      for (uint32_t i = 0; i < types->Length(); i++) {
+        Local<Value> list = bytype->Get(types->Get(i));
+        if (!list->IsArray()) return false;
+        Handle<Array> names = Handle<Array>::Cast(list);
+        if (!allStrings(names)) return false;
+        unsigned int type = types->Get(i)->Uint32Value();
+        if (type >= AIS_MESSAGE_TYPES) continue;
+        std::vector<bool> matched(names->Length());
+        masks[type] = fieldMask(type, names, &matched);
+        given[type] = true;
+        if (!allMatched(names, matched, unknown)) {
+          *unknown += " for type " + std::string(*String::AsciiValue(types->Get(i)));
+          return false;
+        }
+      }
+    }
+    for (unsigned int type = 0; type < AIS_MESSAGE_TYPES; type++) {
+      if (given[type]) setFields(type, masks[type]);
+    }
+    return true;
+  }
+
+  void selectTypes(Handle<Array> types) {
+    uint64_t mask = 0;
+    for (uint32_t i = 0; i < types->Length(); i++) {
+      uint32_t type = types->Get(i)->Uint32Value();
+      if (type < 64) mask |= (uint64_t)1 << type;
+    }
+    ais_select_types(this->ais_handle, mask);
+  }
+
+  uint32_t fieldsFor(const ais_t *ais) const {
+    return ais->type < AIS_MESSAGE_TYPES ? this->fields[ais->type] : ALL_FIELDS;
+  }
+
+  /*!
+    If value is a Buffer or a byte typed array, points data at its
+    contents, narrowed by the optional offset and length arguments.
+    The memory is used in place; nothing is copied.
+  */
+  static bool getBufferData(Handle<Value> value, Handle<Value> offsetval, Handle<Value> lengthval,
+                            const char **data, size_t *len) {
+    if (!value->IsObject()) return false;
+    Handle<Object> obj = value->ToObject();
+    if (node::Buffer::HasInstance(obj)) {
+      *data = node::Buffer::Data(obj);
+      *len = node::Buffer::Length(obj);
+    }
+    else if (obj->HasIndexedPropertiesInExternalArrayData() &&
+             (obj->GetIndexedPropertiesExternalArrayDataType() == kExternalUnsignedByteArray ||
+              obj->GetIndexedPropertiesExternalArrayDataType() == kExternalByteArray ||
+              obj->GetIndexedPropertiesExternalArrayDataType() == kExternalPixelArray)) {
+      *data = static_cast<const char *>(obj->GetIndexedPropertiesExternalArrayData());
+      *len = obj->GetIndexedPropertiesExternalArrayDataLength();
+    }
+    else {
+      return false;
+    }
+
+    size_t offset = 0;
+    if (!offsetval->IsUndefined()) {
+      offset = offsetval->Uint32Value();
+      if (offset > *len) offset = *len;
+    }
+    *data += offset;
+    *len -= offset;
+    if (!lengthval->IsUndefined()) {
+      size_t length = lengthval->Uint32Value();
+      if (length < *len) *len = length;
+    }
+    return true;
+  }
+
+  /*!
+    decode(sentence)
+    decode(buffer, [offset], [length])
+
+    Decodes a single sentence, given either as a string or as a Buffer
+    (or Uint8Array) which is decoded in place. Returns the decoded object,
+    or undefined if the sentence didn't complete a message. If the
+    sentence had an NMEA 4.0 tag block, its time, source and group are in
+    the tagblock property of the object.
+  */
   static Handle<Value> decode(const Arguments& args) {
     HandleScope scope;
     
     AisDecoder *thisp = ObjectWrap::Unwrap<AisDecoder>(args.This());
 
-    String::AsciiValue ascii(args[0]->ToString());
     ais_t ais;
-    bool ret = ais_decode(thisp->ais_handle, 
-                          *ascii, ascii.length(),
-                          &ais,
-                          false, LOG_ERROR);
-
-    Handle<Value> aisobj;
-    if (ret) {
-      aisobj = convertToJS(&ais);
+    const char *data;
+    size_t len;
+    Handle<Value> aisobj = Undefined();
+    uv_mutex_lock(&thisp->mutex);
+    if (getBufferData(args[0], args[1], args[2], &data, &len)) {
+      if (ais_decode(thisp->ais_handle, data, len, &ais, false, LOG_ERROR)) {
+        Handle<Object> obj = convertToJS(&ais, thisp->fieldsFor(&ais));
+        setTagBlock(obj, thisp->ais_handle);
+        aisobj = obj;
+      }
     }
     else {
-      aisobj = Undefined();
+      String::AsciiValue ascii(args[0]->ToString());
+      if (ais_decode(thisp->ais_handle, 
+                     *ascii, ascii.length(),
+                     &ais,
+                     false, LOG_ERROR)) {
+        Handle<Object> obj = convertToJS(&ais, thisp->fieldsFor(&ais));
+        setTagBlock(obj, thisp->ais_handle);
+        aisobj = obj;
+      }
     }
+    uv_mutex_unlock(&thisp->mutex);
 
     return scope.Close(aisobj);
   }
+
+  /*!
+    Sets the tagblock property of a decoded message from the tag block of
+    the sentence completing it, the last one decoded by handle, if it had
+    one. Must be called while that sentence is still in memory.
+  */
+  static void setTagBlock(Handle<Object> aisobj, const ais_handle_t *handle) {
+    struct ais_tagblock_t tag;
+    if (ais_get_tagblock(handle, &tag)) setTagBlock(aisobj, tag);
+  }
+
+  static void setTagBlock(Handle<Object> aisobj, const ais_tagblock_t &tag) {
+    Handle<Object> tagobj = Object::New();
+    if (tag.fields & AIS_TAG_TIME) {
+      tagobj->Set(KEY(time), Number::New(static_cast<double>(tag.time)));
+    }
+    if (tag.fields & AIS_TAG_SOURCE) {
+      tagobj->Set(KEY(source), String::New(tag.source, static_cast<int>(tag.source_len)));
+    }
+    if (tag.fields & AIS_TAG_GROUP) {
+      Handle<Object> group = Object::New();
+      group->Set(KEY(sentence), Integer::NewFromUnsigned(tag.group_sentence));
+      group->Set(KEY(count), Integer::NewFromUnsigned(tag.group_count));
+      group->Set(KEY(id), Integer::NewFromUnsigned(tag.group_id));
+      tagobj->Set(KEY(group), group);
+    }
+    aisobj->Set(KEY(tagblock), tagobj);
+  }
+
+  // userdata for appendToArray()
+  struct ResultArray {
+    AisDecoder *decoder;
+    Handle<Array> results;
+  };
+
+  static void appendToArray(const ais_t *ais, void *userdata) {
+    ResultArray *array = static_cast<ResultArray *>(userdata);
+    Handle<Object> aisobj = convertToJS(const_cast<ais_t *>(ais), array->decoder->fieldsFor(ais));
+    setTagBlock(aisobj, array->decoder->ais_handle);
+    array->results->Set(array->results->Length(), aisobj);
+  }
+
+  /*!
+    Appends a message to results, with the tag block of the last sentence
+    decoded by handle.
+  */
+  static void appendDecoded(std::vector<Decoded> *results, const ais_handle_t *handle,
+                            const ais_t *ais) {
+    results->resize(results->size() + 1);
+    Decoded &decoded = results->back();
+    decoded.ais = *ais;
+    if (ais_get_tagblock(handle, &decoded.tag) && decoded.tag.source) {
+      decoded.source.assign(decoded.tag.source, decoded.tag.source_len);
+    }
+    decoded.tag.source = NULL;
+  }
+
+  // Converts a Decoded to a JS object, on the main thread
+  Handle<Object> convertDecoded(Decoded *decoded) {
+    Handle<Object> aisobj = convertToJS(&decoded->ais, this->fieldsFor(&decoded->ais));
+    if (decoded->tag.fields != 0) {
+      decoded->tag.source = decoded->source.data();
+      setTagBlock(aisobj, decoded->tag);
+    }
+    return aisobj;
+  }
+
+  // userdata for appendToBaton()
+  struct BatonSink {
+    DecodeBaton *baton;
+    const ais_handle_t *handle;
+  };
+
+  static void appendToBaton(const ais_t *ais, void *userdata) {
+    BatonSink *sink = static_cast<BatonSink *>(userdata);
+    appendDecoded(&sink->baton->results, sink->handle, ais);
+  }
+
+  /*!
+    decodeBatch(sentences, [offset], [length])
+
+    Decodes many sentences in one call. sentences is either an array of
+    sentence strings, or a string or Buffer containing newline-delimited
+    sentences (optionally narrowed by offset and length like decode()).
+    Returns an array with one object per completed message; sentences
+    which don't complete a message (e.g. leading fragments of a multipart
+    message, or invalid sentences) don't produce an entry.
+  */
+  static Handle<Value> decodeBatch(const Arguments& args) {
+    HandleScope scope;
+
+    AisDecoder *thisp = ObjectWrap::Unwrap<AisDecoder>(args.This());
+
+    Local<Array> results = Array::New();
+    ResultArray array = { thisp, results };
+    const char *data;
+    size_t len;
+    uv_mutex_lock(&thisp->mutex);
+    if (args[0]->IsArray()) {
+      Handle<Array> sentences = Handle<Array>::Cast(args[0]);
+      uint32_t n = sentences->Length();
+      for (uint32_t i = 0; i < n; i++) {
+        String::AsciiValue ascii(sentences->Get(i)->ToString());
+        ais_t ais;
+        if (ais_decode(thisp->ais_handle, *ascii, ascii.length(), &ais, false, LOG_ERROR)) {
+          appendToArray(&ais, &array);
+        }
+      }
+    }
+    else if (getBufferData(args[0], args[1], args[2], &data, &len)) {
+      ais_decode_lines(thisp->ais_handle, data, len,
+                       appendToArray, &array, false, LOG_ERROR);
+    }
+    else {
+      String::AsciiValue ascii(args[0]->ToString());
+      ais_decode_lines(thisp->ais_handle, *ascii, ascii.length(),
+                       appendToArray, &array, false, LOG_ERROR);
+    }
+    uv_mutex_unlock(&thisp->mutex);
+
+    return scope.Close(results);
+  }
+
+  /*!
+    decodeChunk(chunk, [offset], [length])
+
+    Decodes a chunk of a raw NMEA byte stream, given as a Buffer or string.
+    Chunks may split sentences anywhere; a trailing partial sentence is
+    kept and completed by the next call. Returns an array with one object
+    per completed message.
+  */
+  static Handle<Value> decodeChunk(const Arguments& args) {
+    HandleScope scope;
+
+    AisDecoder *thisp = ObjectWrap::Unwrap<AisDecoder>(args.This());
+
+    Local<Array> results = Array::New();
+    ResultArray array = { thisp, results };
+    const char *data;
+    size_t len;
+    uv_mutex_lock(&thisp->mutex);
+    if (getBufferData(args[0], args[1], args[2], &data, &len)) {
+      ais_decode_stream(thisp->ais_handle, data, len,
+                        appendToArray, &array, false, LOG_ERROR);
+    }
+    else {
+      String::AsciiValue ascii(args[0]->ToString());
+      ais_decode_stream(thisp->ais_handle, *ascii, ascii.length(),
+                        appendToArray, &array, false, LOG_ERROR);
+    }
+    uv_mutex_unlock(&thisp->mutex);
+
+    return scope.Close(results);
+  }
+
+  /*!
+    decodePositions(sentences, records, [index])
+
+    Decodes position reports (types 1-3, 18, 19 and 27) into compact
+    records (struct ais_position_t, in host byte order) instead of
+    objects. sentences is given like for decodeBatch(); records is a
+    Buffer or byte typed array, written from record number index (default
+    0) on. Other messages are skipped, and decoding stops when records is
+    full. Returns the number of records written.
+  */
+  static Handle<Value> decodePositions(const Arguments& args) {
+    HandleScope scope;
+
+    AisDecoder *thisp = ObjectWrap::Unwrap<AisDecoder>(args.This());
+
+    const char *recdata;
+    size_t reclen;
+    if (!getBufferData(args[1], Undefined(), Undefined(), &recdata, &reclen)) {
+      return ThrowException(Exception::TypeError(String::New("records must be a Buffer or a byte typed array")));
+    }
+    size_t capacity = reclen / sizeof(ais_position_t);
+    size_t index = args[2]->IsUndefined() ? 0 : args[2]->Uint32Value();
+    if (index > capacity) index = capacity;
+    // Byte views needn't be aligned for ais_position_t, so records are
+    // copied in bytewise
+    char *out = const_cast<char *>(recdata) + index * sizeof(ais_position_t);
+    size_t count = thisp->decodePositionBlocks(args[0], capacity - index, copyRecords, out);
+
+    return scope.Close(Number::New(count));
+  }
+
+  // Receives a block of n decoded records, the first of which is record
+  // number at of the call
+  typedef void (*PositionSink)(const ais_position_t *block, size_t n, size_t at, void *userdata);
+
+  static void copyRecords(const ais_position_t *block, size_t n, size_t at, void *userdata) {
+    memcpy(static_cast<char *>(userdata) + at * sizeof(ais_position_t), block,
+           n * sizeof(ais_position_t));
+  }
+
+  /*!
+    Decodes the position reports in sentences (given like for
+    decodeBatch()) a block at a time, passing each block to sink.
+    Stops after max records; returns the number decoded.
+  */
+  size_t decodePositionBlocks(Handle<Value> sentences, size_t max,
+                              PositionSink sink, void *userdata) {
+    ais_position_t block[256];
+    const size_t blocksize = sizeof(block) / sizeof(block[0]);
+    size_t count = 0;
+    const char *data;
+    size_t len;
+    uv_mutex_lock(&this->mutex);
+    if (sentences->IsArray()) {
+      Handle<Array> array = Handle<Array>::Cast(sentences);
+      uint32_t n = array->Length();
+      size_t inblock = 0;
+      for (uint32_t i = 0; i < n && count + inblock < max; i++) {
+        String::AsciiValue ascii(array->Get(i)->ToString());
+        if (ais_decode_position(this->ais_handle, *ascii, ascii.length(),
+                                &block[inblock], LOG_ERROR) &&
+            ++inblock == blocksize) {
+          sink(block, inblock, count, userdata);
+          count += inblock;
+          inblock = 0;
+        }
+      }
+      if (inblock > 0) sink(block, inblock, count, userdata);
+      count += inblock;
+    }
+    else {
+      std::string text;
+      if (!getBufferData(sentences, Undefined(), Undefined(), &data, &len)) {
+        String::AsciiValue ascii(sentences->ToString());
+        text.assign(*ascii, ascii.length());
+        data = text.data();
+        len = text.size();
+      }
+      // Resume each block where the previous one stopped
+      while (len > 0 && count < max) {
+        size_t consumed;
+        size_t want = max - count < blocksize ? max - count : blocksize;
+        size_t n = ais_decode_position_lines(this->ais_handle, data, len,
+                                             block, want, &consumed, LOG_ERROR);
+        if (n > 0) sink(block, n, count, userdata);
+        count += n;
+        data += consumed;
+        len -= consumed;
+      }
+    }
+    uv_mutex_unlock(&this->mutex);
+    return count;
+  }
+
+  // Column arrays of decodeColumns(): ais_position_t member, typed array
+  // type, element type and the name of the JS array type
+#define POSITION_COLUMNS(X) \
+  X(mmsi, kExternalUnsignedIntArray, uint32_t, "a Uint32Array") \
+  X(lat, kExternalIntArray, int32_t, "an Int32Array") \
+  X(lon, kExternalIntArray, int32_t, "an Int32Array") \
+  X(speed, kExternalUnsignedShortArray, uint16_t, "a Uint16Array") \
+  X(course, kExternalUnsignedShortArray, uint16_t, "a Uint16Array") \
+  X(heading, kExternalUnsignedShortArray, uint16_t, "a Uint16Array") \
+  X(type, kExternalUnsignedByteArray, uint8_t, "a Uint8Array") \
+  X(status, kExternalUnsignedByteArray, uint8_t, "a Uint8Array") \
+  X(second, kExternalUnsignedByteArray, uint8_t, "a Uint8Array") \
+  X(turn, kExternalByteArray, int8_t, "an Int8Array") \
+  X(flags, kExternalUnsignedByteArray, uint8_t, "a Uint8Array") \
+  X(repeat, kExternalUnsignedByteArray, uint8_t, "a Uint8Array") \
+  X(radio, kExternalUnsignedIntArray, uint32_t, "a Uint32Array")
+
+  struct PositionColumns {
+#define DECLARE_COLUMN(member, arraytype, ctype, jstype) ctype *member;
+    POSITION_COLUMNS(DECLARE_COLUMN)
+#undef DECLARE_COLUMN
+    size_t index; // element receiving the first record
+  };
+
+  /*!
+    Points *data at the elements of obj[name], if it is a typed array of
+    the given type, and narrows *capacity to its length. Returns false if
+    obj[name] is set to anything else.
+  */
+  template <typename T>
+  static bool getColumn(Handle<Object> obj, const char *name, ExternalArrayType type,
+                        T **data, size_t *capacity) {
+    Local<Value> value = obj->Get(String::NewSymbol(name));
+    if (value->IsUndefined()) return true;
+    if (!value->IsObject()) return false;
+    Local<Object> array = value->ToObject();
+    if (!array->HasIndexedPropertiesInExternalArrayData() ||
+        array->GetIndexedPropertiesExternalArrayDataType() != type) {
+      return false;
+    }
+    *data = static_cast<T *>(array->GetIndexedPropertiesExternalArrayData());
+    size_t length = array->GetIndexedPropertiesExternalArrayDataLength();
+    if (length < *capacity) *capacity = length;
+    return true;
+  }
+
+  static void scatterColumns(const ais_position_t *block, size_t n, size_t at, void *userdata) {
+    PositionColumns *columns = static_cast<PositionColumns *>(userdata);
+    size_t base = columns->index + at;
+#define SCATTER_COLUMN(member, arraytype, ctype, jstype) \
+    if (columns->member) { \
+      for (size_t i = 0; i < n; i++) columns->member[base + i] = block[i].member; \
+    }
+    POSITION_COLUMNS(SCATTER_COLUMN)
+#undef SCATTER_COLUMN
+  }
+
+  /*!
+    decodeColumns(sentences, columns, [index])
+
+    Like decodePositions(), but writes each record member into its own
+    typed array ("struct of arrays"), from element index on. columns is an
+    object with any of the arrays listed in POSITION_COLUMNS; members
+    without an array are dropped. Decoding stops when the shortest array
+    is full. Returns the number of records written.
+  */
+  static Handle<Value> decodeColumns(const Arguments& args) {
+    HandleScope scope;
+
+    AisDecoder *thisp = ObjectWrap::Unwrap<AisDecoder>(args.This());
+
+    if (!args[1]->IsObject()) {
+      return ThrowException(Exception::TypeError(String::New("columns must be an object of typed arrays")));
+    }
+    Handle<Object> obj = args[1]->ToObject();
+    PositionColumns columns;
+    const size_t unlimited = static_cast<size_t>(-1);
+    size_t capacity = unlimited;
+#define GET_COLUMN(member, arraytype, ctype, jstype) \
+    columns.member = NULL; \
+    if (!getColumn(obj, #member, arraytype, &columns.member, &capacity)) { \
+      return ThrowException(Exception::TypeError( \
+        String::New("columns." #member " must be " jstype))); \
+    }
+    POSITION_COLUMNS(GET_COLUMN)
+#undef GET_COLUMN
+    if (capacity == unlimited) capacity = 0;
+    size_t index = args[2]->IsUndefined() ? 0 : args[2]->Uint32Value();
+    if (index > capacity) index = capacity;
+    columns.index = index;
+    size_t count = thisp->decodePositionBlocks(args[0], capacity - index, scatterColumns, &columns);
+
+    return scope.Close(Number::New(count));
+  }
+
+  /*!
+    setSource(source)
+
+    Attributes the sentences decoded from now on to source, a number
+    identifying e.g. the receiver or station they came from. Fragments of
+    multipart messages are only joined within one source, so a single
+    decoder can serve a merged feed. Batches already passed to
+    decodeAsync() keep the source set when they were passed.
+  */
+  static Handle<Value> setSource(const Arguments& args) {
+    HandleScope scope;
+
+    AisDecoder *thisp = ObjectWrap::Unwrap<AisDecoder>(args.This());
+
+    if (!args[0]->IsNumber()) {
+      return ThrowException(Exception::TypeError(String::New("source must be a number")));
+    }
+    uv_mutex_lock(&thisp->mutex);
+    thisp->source = args[0]->Uint32Value();
+    ais_set_source(thisp->ais_handle, thisp->source);
+    uv_mutex_unlock(&thisp->mutex);
+
+    return Undefined();
+  }
+
+  /*!
+    reassemblyStats()
+
+    Returns counts of the multipart messages completed, expired and
+    evicted, and of the fragments dropped, since the decoder was created
+    or resetStats() was last called.
+  */
+  static Handle<Value> reassemblyStats(const Arguments& args) {
+    HandleScope scope;
+
+    AisDecoder *thisp = ObjectWrap::Unwrap<AisDecoder>(args.This());
+
+    struct ais_reassembly_stats_t stats;
+    uv_mutex_lock(&thisp->mutex);
+    ais_get_reassembly_stats(thisp->ais_handle, &stats);
+    uv_mutex_unlock(&thisp->mutex);
+
+    return scope.Close(reassemblyObject(stats));
+  }
+
+  static Local<Object> reassemblyObject(const struct ais_reassembly_stats_t &stats) {
+    Local<Object> obj = Object::New();
+    obj->Set(String::NewSymbol("completed"), Number::New(stats.completed));
+    obj->Set(String::NewSymbol("expired"), Number::New(stats.expired));
+    obj->Set(String::NewSymbol("evicted"), Number::New(stats.evicted));
+    obj->Set(String::NewSymbol("dropped"), Number::New(stats.dropped));
+    return obj;
+  }
+
+  // Per-type counts as an object keyed by message type, leaving out zeros
+  static Local<Object> typeCounts(const unsigned long counts[AIS_STATS_TYPES]) {
+    Local<Object> obj = Object::New();
+    for (unsigned int type = 0; type < AIS_STATS_TYPES; type++) {
+      if (counts[type] != 0) obj->Set(type, Number::New(counts[type]));
+    }
+    return obj;
+  }
+
+  /*!
+    checksumErrors()
+
+    Returns the number of sentences rejected for a bad checksum since the
+    decoder was created or resetStats() was last called, when created with
+    the verifyChecksum option.
+  */
+  static Handle<Value> checksumErrors(const Arguments& args) {
+    HandleScope scope;
+
+    AisDecoder *thisp = ObjectWrap::Unwrap<AisDecoder>(args.This());
+
+    uv_mutex_lock(&thisp->mutex);
+    unsigned long errors = ais_get_checksum_errors(thisp->ais_handle);
+    uv_mutex_unlock(&thisp->mutex);
+
+    return scope.Close(Number::New(errors));
+  }
+
+  /*!
+    stats()
+
+    Returns the statistics kept since the decoder was created or
+    resetStats() was last called:
+
+      sentences    the number of sentences passed in
+      rejected     sentences rejected before making up a message, by
+                   reason: overlong, checksum, malformed, channel,
+                   fragment, payload, filtered and tagblock
+      decoded      messages decoded, by type
+      undecoded    messages assembled but not decoded, by type
+      reassembly   as returned by reassemblyStats()
+      timing       decode times of one sentence in 64: samples, the
+                   total nanoseconds, and a histogram of 16 counts,
+                   the first of times under 64 ns, each next one of
+                   times up to twice as long, the last of all longer
+  */
+  static Handle<Value> stats(const Arguments& args) {
+    HandleScope scope;
+
+    AisDecoder *thisp = ObjectWrap::Unwrap<AisDecoder>(args.This());
+
+    struct ais_stats_t stats;
+    uv_mutex_lock(&thisp->mutex);
+    ais_get_stats(thisp->ais_handle, &stats);
+    uv_mutex_unlock(&thisp->mutex);
+
+    Local<Object> rejected = Object::New();
+#define SET_REJECT(NAME, name) \
+    rejected->Set(String::NewSymbol(name), Number::New(stats.rejected[AIS_REJECT_##NAME]));
+    AIS_REJECTS(SET_REJECT)
+#undef SET_REJECT
+
+    Local<Array> histogram = Array::New(AIS_TIME_BUCKETS);
+    for (unsigned int i = 0; i < AIS_TIME_BUCKETS; i++) {
+      histogram->Set(i, Number::New(stats.time_histogram[i]));
+    }
+    Local<Object> timing = Object::New();
+    timing->Set(String::NewSymbol("samples"), Number::New(stats.timed));
+    timing->Set(String::NewSymbol("nanoseconds"), Number::New(stats.timed_nsec));
+    timing->Set(String::NewSymbol("histogram"), histogram);
+
+    Local<Object> obj = Object::New();
+    obj->Set(String::NewSymbol("sentences"), Number::New(stats.sentences));
+    obj->Set(String::NewSymbol("rejected"), rejected);
+    obj->Set(String::NewSymbol("decoded"), typeCounts(stats.decoded));
+    obj->Set(String::NewSymbol("undecoded"), typeCounts(stats.undecoded));
+    obj->Set(String::NewSymbol("reassembly"), reassemblyObject(stats.reassembly));
+    obj->Set(String::NewSymbol("timing"), timing);
+    return scope.Close(obj);
+  }
+
+  /*!
+    resetStats()
+
+    Zeroes the statistics returned by stats(), reassemblyStats() and
+    checksumErrors().
+  */
+  static Handle<Value> resetStats(const Arguments& args) {
+    HandleScope scope;
+
+    AisDecoder *thisp = ObjectWrap::Unwrap<AisDecoder>(args.This());
+
+    uv_mutex_lock(&thisp->mutex);
+    ais_reset_stats(thisp->ais_handle);
+    uv_mutex_unlock(&thisp->mutex);
+
+    return Undefined();
+  }
+
+  // An update number of the vessel table; 0 if undefined or negative
+  static uint64_t updateNumber(Handle<Value> value) {
+    int64_t n = value->IntegerValue();
+    return n > 0 ? static_cast<uint64_t>(n) : 0;
+  }
+
+  static Handle<Value> noVesselTable() {
+    return ThrowException(Exception::Error(
+      String::New("the decoder keeps no vessel table; create it with the vessels option")));
+  }
+
+  /*!
+    vessel(mmsi)
+
+    Returns the last known state of a vessel, merged from the messages
+    decoded since the decoder was created with options.vessels, or
+    undefined if none came from it.
+  */
+  static Handle<Value> vessel(const Arguments& args) {
+    HandleScope scope;
+
+    AisDecoder *thisp = ObjectWrap::Unwrap<AisDecoder>(args.This());
+    if (!thisp->vessel_table) return noVesselTable();
+
+    ais_vessel_t record;
+    uv_mutex_lock(&thisp->mutex);
+    bool found = ais_vessel_get(thisp->vessel_table, args[0]->Uint32Value(), &record);
+    uv_mutex_unlock(&thisp->mutex);
+
+    if (!found) return Undefined();
+    return scope.Close(convertVessel(&record));
+  }
+
+  /*!
+    vessels([since])
+
+    Returns an array of the last known states of all vessels in the
+    table, like vessel(), or only of those updated after update number
+    since. Each has the number of its last update as updated, so the
+    largest one seen can be passed as since to get only later changes.
+  */
+  static Handle<Value> vessels(const Arguments& args) {
+    HandleScope scope;
+
+    AisDecoder *thisp = ObjectWrap::Unwrap<AisDecoder>(args.This());
+    if (!thisp->vessel_table) return noVesselTable();
+
+    uint64_t since = updateNumber(args[0]);
+    uv_mutex_lock(&thisp->mutex);
+    std::vector<ais_vessel_t> snapshot(ais_vessel_count(thisp->vessel_table));
+    if (!snapshot.empty()) {
+      snapshot.resize(ais_vessel_snapshot(thisp->vessel_table, since, &snapshot[0], snapshot.size()));
+    }
+    uv_mutex_unlock(&thisp->mutex);
+
+    Local<Array> results = Array::New(snapshot.size());
+    for (size_t i = 0; i < snapshot.size(); i++) {
+      results->Set(i, convertVessel(&snapshot[i]));
+    }
+    return scope.Close(results);
+  }
+
+  /*!
+    vesselUpdates()
+
+    Returns the number of the last update of the vessel table. Updates
+    are numbered from 1, one per message merged in.
+  */
+  static Handle<Value> vesselUpdates(const Arguments& args) {
+    HandleScope scope;
+
+    AisDecoder *thisp = ObjectWrap::Unwrap<AisDecoder>(args.This());
+    if (!thisp->vessel_table) return noVesselTable();
+
+    uv_mutex_lock(&thisp->mutex);
+    uint64_t updates = ais_vessel_updates(thisp->vessel_table);
+    uv_mutex_unlock(&thisp->mutex);
+
+    return scope.Close(Number::New(static_cast<double>(updates)));
+  }
+
+  /*!
+    expireVessels(since)
+
+    Removes the vessels not updated after update number since, e.g. a
+    vesselUpdates() taken a while ago, making room for others. Returns
+    the number of vessels removed.
+  */
+  static Handle<Value> expireVessels(const Arguments& args) {
+    HandleScope scope;
+
+    AisDecoder *thisp = ObjectWrap::Unwrap<AisDecoder>(args.This());
+    if (!thisp->vessel_table) return noVesselTable();
+
+    uint64_t since = updateNumber(args[0]);
+    uv_mutex_lock(&thisp->mutex);
+    size_t removed = ais_vessel_expire(thisp->vessel_table, since);
+    uv_mutex_unlock(&thisp->mutex);
+
+    return scope.Close(Number::New(removed));
+  }
+
+  /*!
+    decodeAsync(sentences, callback)
+
+    Like decodeBatch(), but decodes on the libuv thread pool and calls
+    callback(err, results) when done. Batches passed to the same decoder
+    are decoded one at a time in call order, so multipart messages may
+    span batches. A Buffer passed as sentences is read in place and must
+    not be modified until the callback has been called. The decoder is
+    locked for ASYNC_SUB_BATCH sentences at a time, so synchronous calls
+    meanwhile wait for at most that many and are decoded between them.
+  */
+  static Handle<Value> decodeAsync(const Arguments& args) {
+    HandleScope scope;
+
+    AisDecoder *thisp = ObjectWrap::Unwrap<AisDecoder>(args.This());
+
+    if (!args[1]->IsFunction()) {
+      return ThrowException(Exception::TypeError(String::New("callback must be a function")));
+    }
+
+    DecodeBaton *baton = new DecodeBaton;
+    baton->request.data = baton;
+    baton->decoder = thisp;
+    baton->callback = Persistent<Function>::New(Handle<Function>::Cast(args[1]));
+    baton->data = NULL;
+    baton->len = 0;
+    baton->source = thisp->source;
+    if (args[0]->IsArray()) {
+      Handle<Array> sentences = Handle<Array>::Cast(args[0]);
+      uint32_t n = sentences->Length();
+      baton->sentences.reserve(n);
+      for (uint32_t i = 0; i < n; i++) {
+        String::AsciiValue ascii(sentences->Get(i)->ToString());
+        baton->sentences.push_back(std::string(*ascii, ascii.length()));
+      }
+    }
+    else if (getBufferData(args[0], Undefined(), Undefined(), &baton->data, &baton->len)) {
+      baton->buffer = Persistent<Object>::New(args[0]->ToObject());
+    }
+    else {
+      String::AsciiValue ascii(args[0]->ToString());
+      baton->text.assign(*ascii, ascii.length());
+      baton->data = baton->text.data();
+      baton->len = baton->text.size();
+    }
+
+    thisp->Ref();
+    thisp->pending.push_back(baton);
+    thisp->startNext();
+
+    return Undefined();
+  }
+
+  /*!
+    decodeFile(path, [options], ondata, callback)
+
+    Decodes a file of newline-delimited sentences, such as an archived
+    log, on options.threads threads (one per CPU by default), reading it
+    through a memory map. ondata(results) is called with arrays of the
+    decoded objects in file order, and callback(err, count) once the whole
+    file is done. The decoder's settings apply and its statistics include
+    the file, but its multipart reassembly state is neither used nor
+    changed. Multipart messages split between the threads' chunks of the
+    file are still reassembled.
+  */
+  static Handle<Value> decodeFile(const Arguments& args) {
+    HandleScope scope;
+
+    AisDecoder *thisp = ObjectWrap::Unwrap<AisDecoder>(args.This());
+
+    int next = 1;
+    unsigned int threads = 0;
+    if (args[1]->IsObject() && !args[1]->IsFunction()) {
+      Handle<Value> value = args[1]->ToObject()->Get(String::NewSymbol("threads"));
+      if (!value->IsUndefined() && !value->IsNumber()) {
+        return ThrowException(Exception::TypeError(String::New("threads must be a number")));
+      }
+      threads = value->IsUndefined() ? 0 : value->Uint32Value();
+      next = 2;
+    }
+    if (!args[0]->IsString() || !args[next]->IsFunction() || !args[next + 1]->IsFunction()) {
+      return ThrowException(Exception::TypeError(
+        String::New("decodeFile takes a path, [options], an ondata function and a callback")));
+    }
+
+    FileBaton *baton = new FileBaton;
+    baton->request.data = baton;
+    baton->async.data = baton;
+    baton->decoder = thisp;
+    baton->ondata = Persistent<Function>::New(Handle<Function>::Cast(args[next]));
+    baton->callback = Persistent<Function>::New(Handle<Function>::Cast(args[next + 1]));
+    String::Utf8Value path(args[0]);
+    baton->path.assign(*path, path.length());
+    baton->threads = threads;
+    baton->handle = ais_create_handle();
+    uv_mutex_lock(&thisp->mutex);
+    ais_copy_settings(baton->handle, thisp->ais_handle);
+    uv_mutex_unlock(&thisp->mutex);
+    baton->batch = new std::vector<Decoded>;
+    baton->count = 0;
+    baton->error = 0;
+    uv_mutex_init(&baton->mutex);
+    uv_cond_init(&baton->cond);
+    uv_async_init(uv_default_loop(), &baton->async, fileDeliver);
+
+    thisp->Ref();
+    uv_queue_work(uv_default_loop(), &baton->request, fileWork, fileAfter);
+
+    return Undefined();
+  }
+
+  static void fileWork(uv_work_t *req) {
+    FileBaton *baton = static_cast<FileBaton *>(req->data);
+    baton->count = ais_decode_file(baton->handle, baton->path.c_str(), baton->threads,
+                                   appendToFileBatch, baton, false, LOG_ERROR);
+    if (baton->count < 0) baton->error = errno;
+    if (!baton->batch->empty()) queueFileBatch(baton);
+  }
+
+  // Called on the thread pool for each message, in file order
+  static void appendToFileBatch(const ais_t *ais, void *userdata) {
+    FileBaton *baton = static_cast<FileBaton *>(userdata);
+    appendDecoded(baton->batch, baton->handle, ais);
+    if (baton->batch->size() >= FILE_BATCH) queueFileBatch(baton);
+  }
+
+  static void queueFileBatch(FileBaton *baton) {
+    uv_mutex_lock(&baton->mutex);
+    while (baton->batches.size() >= FILE_BATCHES_PENDING) {
+      uv_cond_wait(&baton->cond, &baton->mutex);
+    }
+    baton->batches.push_back(baton->batch);
+    uv_mutex_unlock(&baton->mutex);
+    baton->batch = new std::vector<Decoded>;
+    uv_async_send(&baton->async);
+  }
+
+  static void fileDeliver(uv_async_t *handle, int status) {
+    HandleScope scope;
+    deliverFileBatches(static_cast<FileBaton *>(handle->data));
+  }
+
+  // Passes the waiting batches to ondata, on the main thread
+  static void deliverFileBatches(FileBaton *baton) {
+    std::deque<std::vector<Decoded> *> batches;
+    uv_mutex_lock(&baton->mutex);
+    batches.swap(baton->batches);
+    uv_cond_signal(&baton->cond);
+    uv_mutex_unlock(&baton->mutex);
+
+    AisDecoder *thisp = baton->decoder;
+    for (size_t b = 0; b < batches.size(); b++) {
+      std::vector<Decoded> &batch = *batches[b];
+      // The file's own handle has no vessel table; merge in file order here
+      if (thisp->vessel_table) {
+        uint32_t skip[AIS_MESSAGE_TYPES];
+        for (unsigned int type = 0; type < AIS_MESSAGE_TYPES; type++) skip[type] = ~thisp->fields[type];
+        uv_mutex_lock(&thisp->mutex);
+        for (size_t i = 0; i < batch.size(); i++) ais_vessel_update(thisp->vessel_table, &batch[i].ais, skip);
+        uv_mutex_unlock(&thisp->mutex);
+      }
+      Local<Array> results = Array::New(batch.size());
+      for (size_t i = 0; i < batch.size(); i++) {
+        results->Set(i, thisp->convertDecoded(&batch[i]));
+      }
+      delete batches[b];
+      Handle<Value> argv[1] = { results };
+      TryCatch try_catch;
+      baton->ondata->Call(Context::GetCurrent()->Global(), 1, argv);
+      if (try_catch.HasCaught()) {
+        node::FatalException(try_catch);
+      }
+    }
+  }
+
+  static void fileAfter(uv_work_t *req, int status) {
+    HandleScope scope;
+    FileBaton *baton = static_cast<FileBaton *>(req->data);
+    AisDecoder *thisp = baton->decoder;
+
+    // Batches queued since the last async callback
+    deliverFileBatches(baton);
+
+    struct ais_stats_t stats;
+    ais_get_stats(baton->handle, &stats);
+    uv_mutex_lock(&thisp->mutex);
+    ais_add_stats(thisp->ais_handle, &stats);
+    uv_mutex_unlock(&thisp->mutex);
+
+    Handle<Value> argv[2];
+    if (baton->count < 0) {
+      std::string message = baton->path + ": " + strerror(baton->error);
+      argv[0] = Exception::Error(String::New(message.c_str()));
+      argv[1] = Undefined();
+    }
+    else {
+      argv[0] = Null();
+      argv[1] = Number::New(baton->count);
+    }
+    TryCatch try_catch;
+    baton->callback->Call(Context::GetCurrent()->Global(), 2, argv);
+    if (try_catch.HasCaught()) {
+      node::FatalException(try_catch);
+    }
+
+    uv_close(reinterpret_cast<uv_handle_t *>(&baton->async), fileClosed);
+    thisp->Unref();
+  }
+
+  static void fileClosed(uv_handle_t *handle) {
+    FileBaton *baton = static_cast<FileBaton *>(handle->data);
+    baton->ondata.Dispose();
+    baton->callback.Dispose();
+    uv_cond_destroy(&baton->cond);
+    uv_mutex_destroy(&baton->mutex);
+    ais_destroy_handle(baton->handle);
+    delete baton->batch;
+    delete baton;
+  }
+
+  void startNext() {
+    if (this->busy || this->pending.empty()) return;
+    DecodeBaton *baton = this->pending.front();
+    this->pending.pop_front();
+    this->busy = true;
+    uv_queue_work(uv_default_loop(), &baton->request, decodeWork, decodeAfter);
+  }
+
+  static void decodeWork(uv_work_t *req) {
+    DecodeBaton *baton = static_cast<DecodeBaton *>(req->data);
+    AisDecoder *thisp = baton->decoder;
+
+    // The handle is locked for ASYNC_SUB_BATCH sentences at a time, so
+    // calls on the main thread never wait for a whole batch
+    BatonSink sink = { baton, thisp->ais_handle };
+    if (baton->data) {
+      const char *data = baton->data;
+      const char *end = data + baton->len;
+      while (data < end) {
+        const char *cut = data;
+        for (size_t n = 0; n < ASYNC_SUB_BATCH && cut < end; n++) {
+          const char *eol = static_cast<const char *>(memchr(cut, '\n', end - cut));
+          cut = eol ? eol + 1 : end;
+        }
+        thisp->lockSource(baton->source);
+        ais_decode_lines(thisp->ais_handle, data, cut - data,
+                         appendToBaton, &sink, false, LOG_ERROR);
+        thisp->unlockSource();
+        data = cut;
+      }
+    }
+    else {
+      size_t n = baton->sentences.size();
+      for (size_t i = 0; i < n; ) {
+        size_t stop = n - i < ASYNC_SUB_BATCH ? n : i + ASYNC_SUB_BATCH;
+        thisp->lockSource(baton->source);
+        for (; i < stop; i++) {
+          ais_t ais;
+          if (ais_decode(thisp->ais_handle,
+                         baton->sentences[i].data(), baton->sentences[i].size(),
+                         &ais, false, LOG_ERROR)) {
+            appendDecoded(&baton->results, thisp->ais_handle, &ais);
+          }
+        }
+        thisp->unlockSource();
+      }
+    }
+  }
+
+  // Locks the handle for decoding sentences of a batch from source
+  void lockSource(unsigned int source) {
+    uv_mutex_lock(&this->mutex);
+    ais_set_source(this->ais_handle, source);
+  }
+
+  // Restores the source of setSource() and unlocks the handle
+  void unlockSource() {
+    ais_set_source(this->ais_handle, this->source);
+    uv_mutex_unlock(&this->mutex);
+  }
+
+  static void decodeAfter(uv_work_t *req, int status) {
+    HandleScope scope;
+    DecodeBaton *baton = static_cast<DecodeBaton *>(req->data);
+    AisDecoder *thisp = baton->decoder;
+
+    Local<Array> results = Array::New(baton->results.size());
+    for (size_t i = 0; i < baton->results.size(); i++) {
+      results->Set(i, thisp->convertDecoded(&baton->results[i]));
+    }
+    Handle<Value> argv[2] = { Null(), results };
+
+    // Start the next batch before calling back, so that work submitted
+    // from the callback is queued behind it
+    thisp->busy = false;
+    thisp->startNext();
+
+    TryCatch try_catch;
+    baton->callback->Call(Context::GetCurrent()->Global(), 2, argv);
+    if (try_catch.HasCaught()) {
+      node::FatalException(try_catch);
+    }
+
+    baton->callback.Dispose();
+    if (!baton->buffer.IsEmpty()) baton->buffer.Dispose();
+    delete baton;
+    thisp->Unref();
+  }
 };
 
 void InitAll(Handle<Object> exports) {
+  initKeys();
   AisDecoder::Init(exports);
 }
 
@@ -11,6 +11,8 @@
 
 #define AIVDM_ENABLE 1
 
+#define AIS_MESSAGE_TYPES	28	/* message types are 0-27 */
+
 /*
  * Is an MMSI number that of an auxiliary associated with a mother ship?
  * We need to be able to test this for decoding AIS Type 24 messages.
@@ -0,0 +1,51 @@
+/*
+ * Field descriptor tables for the fixed-format AIS messages, generated
+ * from the layouts in ais_layout.h.
+ */
+#include <stddef.h>
+
+#include "ais_layout.h"
+
+#define AIS_FIELD_KIND_U	ais_field_unsigned
+#define AIS_FIELD_KIND_S	ais_field_signed
+#define AIS_FIELD_KIND_B	ais_field_bool
+#define AIS_FIELD_KIND_C	ais_field_text
+
+#define AIS_DESCRIBE(kind, group, member, start, width) \
+    { #member, AIS_FIELD_KIND_##kind, start, width, \
+      offsetof(struct ais_t, group.member), \
+      sizeof(((struct ais_t *)0)->group.member) },
+
+#define AIS_DEFINE_LAYOUT(NAME) \
+    static const struct ais_field_t NAME##_fields[] = { \
+	AIS_##NAME##_FIELDS(AIS_DESCRIBE) \
+    }; \
+    static const struct ais_layout_t NAME##_layout = { \
+	AIS_##NAME##_BITS, NAME##_fields, \
+	sizeof(NAME##_fields) / sizeof(NAME##_fields[0]) \
+    };
+
+AIS_DEFINE_LAYOUT(TYPE1)
+AIS_DEFINE_LAYOUT(TYPE4)
+AIS_DEFINE_LAYOUT(TYPE5)
+AIS_DEFINE_LAYOUT(TYPE9)
+AIS_DEFINE_LAYOUT(TYPE10)
+AIS_DEFINE_LAYOUT(TYPE18)
+AIS_DEFINE_LAYOUT(TYPE19)
+AIS_DEFINE_LAYOUT(TYPE20)
+AIS_DEFINE_LAYOUT(TYPE21)
+AIS_DEFINE_LAYOUT(TYPE23)
+AIS_DEFINE_LAYOUT(TYPE27)
+
+#define AIS_LAYOUT_ENTRY(type, NAME)	[type] = &NAME##_layout,
+
+static const struct ais_layout_t *const layouts[AIS_MESSAGE_TYPES] = {
+    AIS_LAYOUTS(AIS_LAYOUT_ENTRY)
+};
+
+const struct ais_layout_t *ais_layout(unsigned int type)
+{
+    if (type >= sizeof(layouts) / sizeof(layouts[0]))
+	return NULL;
+    return layouts[type];
+}
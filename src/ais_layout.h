@@ -0,0 +1,275 @@
+#ifndef AIS_LAYOUT_H_
+#define AIS_LAYOUT_H_
+
+/*
+ * Bit layouts of the fixed-format AIS messages.
+ *
+ * Each layout is an X-macro list of X(kind, group, member, start, width)
+ * entries, where ais->group.member receives the field at bit offset
+ * start. kind is one of
+ *
+ *   U  unsigned integer, width bits
+ *   S  signed (two's complement) integer, width bits
+ *   B  boolean flag, width bits (always 1)
+ *   C  six-bit text, width characters
+ *
+ * ais_binary_decode() expands these lists into straight-line extraction
+ * code for each message type; ais_layout() expands them into descriptor
+ * tables, so other code can walk the same fields generically. Fields
+ * whose presence depends on the message length or on other fields are
+ * decoded by hand and are not listed here.
+ */
+
+#include "ais.h"
+
+/* Types 1-3: Common navigation info */
+#define AIS_TYPE1_BITS	168
+#define AIS_TYPE1_FIELDS(X) \
+    X(U, type1, status,		38,  4) \
+    X(S, type1, turn,		42,  8) \
+    X(U, type1, speed,		50, 10) \
+    X(B, type1, accuracy,	60,  1) \
+    X(S, type1, lon,		61, 28) \
+    X(S, type1, lat,		89, 27) \
+    X(U, type1, course,		116, 12) \
+    X(U, type1, heading,	128, 9) \
+    X(U, type1, second,		137, 6) \
+    X(U, type1, maneuver,	143, 2) \
+    X(B, type1, raim,		148, 1) \
+    X(U, type1, radio,		149, 19)
+
+/* Types 4 and 11: Base Station Report and UTC/Date Response */
+#define AIS_TYPE4_BITS	168
+#define AIS_TYPE4_FIELDS(X) \
+    X(U, type4, year,		38, 14) \
+    X(U, type4, month,		52,  4) \
+    X(U, type4, day,		56,  5) \
+    X(U, type4, hour,		61,  5) \
+    X(U, type4, minute,		66,  6) \
+    X(U, type4, second,		72,  6) \
+    X(B, type4, accuracy,	78,  1) \
+    X(S, type4, lon,		79, 28) \
+    X(S, type4, lat,		107, 27) \
+    X(U, type4, epfd,		134, 4) \
+    X(B, type4, raim,		148, 1) \
+    X(U, type4, radio,		149, 19)
+
+/* Type 5: Ship static and voyage related data (dte is read by hand) */
+#define AIS_TYPE5_BITS	424
+#define AIS_TYPE5_FIELDS(X) \
+    X(U, type5, ais_version,	38,  2) \
+    X(U, type5, imo,		40, 30) \
+    X(C, type5, callsign,	70,  7) \
+    X(C, type5, shipname,	112, 20) \
+    X(U, type5, shiptype,	232, 8) \
+    X(U, type5, to_bow,		240, 9) \
+    X(U, type5, to_stern,	249, 9) \
+    X(U, type5, to_port,	258, 6) \
+    X(U, type5, to_starboard,	264, 6) \
+    X(U, type5, epfd,		270, 4) \
+    X(U, type5, month,		274, 4) \
+    X(U, type5, day,		278, 5) \
+    X(U, type5, hour,		283, 5) \
+    X(U, type5, minute,		288, 6) \
+    X(U, type5, draught,	294, 8) \
+    X(C, type5, destination,	302, 20)
+
+/* Type 9: Standard SAR Aircraft Position Report */
+#define AIS_TYPE9_BITS	168
+#define AIS_TYPE9_FIELDS(X) \
+    X(U, type9, alt,		38, 12) \
+    X(U, type9, speed,		50, 10) \
+    X(B, type9, accuracy,	60,  1) \
+    X(S, type9, lon,		61, 28) \
+    X(S, type9, lat,		89, 27) \
+    X(U, type9, course,		116, 12) \
+    X(U, type9, second,		128, 6) \
+    X(U, type9, regional,	134, 8) \
+    X(U, type9, dte,		142, 1) \
+    X(B, type9, assigned,	146, 1) \
+    X(B, type9, raim,		147, 1) \
+    X(U, type9, radio,		148, 19)
+
+/* Type 10: UTC/Date inquiry */
+#define AIS_TYPE10_BITS	72
+#define AIS_TYPE10_FIELDS(X) \
+    X(U, type10, dest_mmsi,	40, 30)
+
+/* Type 18: Standard Class B CS Position Report */
+#define AIS_TYPE18_BITS	168
+#define AIS_TYPE18_FIELDS(X) \
+    X(U, type18, reserved,	38,  8) \
+    X(U, type18, speed,		46, 10) \
+    X(B, type18, accuracy,	56,  1) \
+    X(S, type18, lon,		57, 28) \
+    X(S, type18, lat,		85, 27) \
+    X(U, type18, course,	112, 12) \
+    X(U, type18, heading,	124, 9) \
+    X(U, type18, second,	133, 6) \
+    X(U, type18, regional,	139, 2) \
+    X(B, type18, cs,		141, 1) \
+    X(B, type18, display,	142, 1) \
+    X(B, type18, dsc,		143, 1) \
+    X(B, type18, band,		144, 1) \
+    X(B, type18, msg22,		145, 1) \
+    X(B, type18, assigned,	146, 1) \
+    X(B, type18, raim,		147, 1) \
+    X(U, type18, radio,		148, 20)
+
+/* Type 19: Extended Class B CS Position Report */
+#define AIS_TYPE19_BITS	312
+#define AIS_TYPE19_FIELDS(X) \
+    X(U, type19, reserved,	38,  8) \
+    X(U, type19, speed,		46, 10) \
+    X(B, type19, accuracy,	56,  1) \
+    X(S, type19, lon,		57, 28) \
+    X(S, type19, lat,		85, 27) \
+    X(U, type19, course,	112, 12) \
+    X(U, type19, heading,	124, 9) \
+    X(U, type19, second,	133, 6) \
+    X(U, type19, regional,	139, 4) \
+    X(C, type19, shipname,	143, 20) \
+    X(U, type19, shiptype,	263, 8) \
+    X(U, type19, to_bow,	271, 9) \
+    X(U, type19, to_stern,	280, 9) \
+    X(U, type19, to_port,	289, 6) \
+    X(U, type19, to_starboard,	295, 6) \
+    X(U, type19, epfd,		301, 4) \
+    X(B, type19, raim,		305, 1) \
+    X(B, type19, dte,		306, 1) \
+    X(B, type19, assigned,	307, 1)
+
+/* Type 20: Data Link Management Message */
+#define AIS_TYPE20_BITS	160
+#define AIS_TYPE20_FIELDS(X) \
+    X(U, type20, offset1,	40, 12) \
+    X(U, type20, number1,	52,  4) \
+    X(U, type20, timeout1,	56,  3) \
+    X(U, type20, increment1,	59, 11) \
+    X(U, type20, offset2,	70, 12) \
+    X(U, type20, number2,	82,  4) \
+    X(U, type20, timeout2,	86,  3) \
+    X(U, type20, increment2,	89, 11) \
+    X(U, type20, offset3,	100, 12) \
+    X(U, type20, number3,	112, 4) \
+    X(U, type20, timeout3,	116, 3) \
+    X(U, type20, increment3,	119, 11) \
+    X(U, type20, offset4,	130, 12) \
+    X(U, type20, number4,	142, 4) \
+    X(U, type20, timeout4,	146, 3) \
+    X(U, type20, increment4,	149, 11)
+
+/* Type 21: Aid-to-Navigation Report (the name extension is read by hand) */
+#define AIS_TYPE21_BITS	272
+#define AIS_TYPE21_FIELDS(X) \
+    X(U, type21, aid_type,	38,  5) \
+    X(C, type21, name,		43, 20) \
+    X(B, type21, accuracy,	163, 1) \
+    X(S, type21, lon,		164, 28) \
+    X(S, type21, lat,		192, 27) \
+    X(U, type21, to_bow,	219, 9) \
+    X(U, type21, to_stern,	228, 9) \
+    X(U, type21, to_port,	237, 6) \
+    X(U, type21, to_starboard,	243, 6) \
+    X(U, type21, epfd,		249, 4) \
+    X(U, type21, second,	253, 6) \
+    X(B, type21, off_position,	259, 1) \
+    X(U, type21, regional,	260, 8) \
+    X(B, type21, raim,		268, 1) \
+    X(B, type21, virtual_aid,	269, 1) \
+    X(B, type21, assigned,	270, 1)
+
+/* Type 23: Group Assignment Command */
+#define AIS_TYPE23_BITS	160
+#define AIS_TYPE23_FIELDS(X) \
+    X(S, type23, ne_lon,	40, 18) \
+    X(S, type23, ne_lat,	58, 17) \
+    X(S, type23, sw_lon,	75, 18) \
+    X(S, type23, sw_lat,	93, 17) \
+    X(U, type23, stationtype,	110, 4) \
+    X(U, type23, shiptype,	114, 8) \
+    X(U, type23, txrx,		144, 4) \
+    X(U, type23, interval,	146, 4) \
+    X(U, type23, quiet,		150, 4)
+
+/* Type 27: Long Range AIS Broadcast message */
+#define AIS_TYPE27_BITS	96
+#define AIS_TYPE27_FIELDS(X) \
+    X(B, type27, accuracy,	38,  1) \
+    X(B, type27, raim,		39,  1) \
+    X(U, type27, status,	40,  4) \
+    X(S, type27, lon,		44, 18) \
+    X(S, type27, lat,		62, 17) \
+    X(U, type27, speed,		79,  6) \
+    X(U, type27, course,	85,  9) \
+    X(B, type27, gnss,		94,  1)
+
+/* every fixed-format layout, as X(type, NAME) pairs */
+#define AIS_LAYOUTS(X) \
+    X(1, TYPE1) X(2, TYPE1) X(3, TYPE1) X(4, TYPE4) X(5, TYPE5) \
+    X(9, TYPE9) X(10, TYPE10) X(11, TYPE4) X(18, TYPE18) \
+    X(19, TYPE19) X(20, TYPE20) X(21, TYPE21) X(23, TYPE23) \
+    X(27, TYPE27)
+
+/* every layout's fields are numbered from 0, e.g. AIS_type1_lon */
+#define AIS_FIELD_INDEX(kind, group, member, start, width) \
+    AIS_##group##_##member,
+enum { AIS_TYPE1_FIELDS(AIS_FIELD_INDEX) };
+enum { AIS_TYPE4_FIELDS(AIS_FIELD_INDEX) };
+enum { AIS_TYPE5_FIELDS(AIS_FIELD_INDEX) };
+enum { AIS_TYPE9_FIELDS(AIS_FIELD_INDEX) };
+enum { AIS_TYPE10_FIELDS(AIS_FIELD_INDEX) };
+enum { AIS_TYPE18_FIELDS(AIS_FIELD_INDEX) };
+enum { AIS_TYPE19_FIELDS(AIS_FIELD_INDEX) };
+enum { AIS_TYPE20_FIELDS(AIS_FIELD_INDEX) };
+enum { AIS_TYPE21_FIELDS(AIS_FIELD_INDEX) };
+enum { AIS_TYPE23_FIELDS(AIS_FIELD_INDEX) };
+enum { AIS_TYPE27_FIELDS(AIS_FIELD_INDEX) };
+
+/* where each field is, as arguments to ubits_be(): AIS_FIELD_AT(type1, lon) */
+#define AIS_FIELD_POSITION(kind, group, member, start, width) \
+    AIS_##group##_##member##_START = start, AIS_##group##_##member##_WIDTH = width,
+enum { AIS_TYPE1_FIELDS(AIS_FIELD_POSITION) };
+enum { AIS_TYPE4_FIELDS(AIS_FIELD_POSITION) };
+enum { AIS_TYPE5_FIELDS(AIS_FIELD_POSITION) };
+enum { AIS_TYPE9_FIELDS(AIS_FIELD_POSITION) };
+enum { AIS_TYPE10_FIELDS(AIS_FIELD_POSITION) };
+enum { AIS_TYPE18_FIELDS(AIS_FIELD_POSITION) };
+enum { AIS_TYPE19_FIELDS(AIS_FIELD_POSITION) };
+enum { AIS_TYPE20_FIELDS(AIS_FIELD_POSITION) };
+enum { AIS_TYPE21_FIELDS(AIS_FIELD_POSITION) };
+enum { AIS_TYPE23_FIELDS(AIS_FIELD_POSITION) };
+enum { AIS_TYPE27_FIELDS(AIS_FIELD_POSITION) };
+#define AIS_FIELD_AT(group, member) \
+    AIS_##group##_##member##_START, AIS_##group##_##member##_WIDTH
+
+/* bit of a field in field masks; layouts have at most 32 fields */
+#define AIS_FIELD_BIT(group, member)	(1u << AIS_##group##_##member)
+
+enum ais_field_kind_t {
+    ais_field_unsigned,
+    ais_field_signed,
+    ais_field_bool,
+    ais_field_text,
+};
+
+/* descriptor of one field, generated from the lists above */
+struct ais_field_t {
+    const char *name;		/* member name, e.g. "lon" */
+    enum ais_field_kind_t kind;
+    unsigned short start;	/* bit offset in the message */
+    unsigned short width;	/* bits, or characters for text */
+    unsigned short offset;	/* byte offset of the member in ais_t */
+    unsigned short size;	/* sizeof the member */
+};
+
+struct ais_layout_t {
+    unsigned int bits;		/* nominal message length */
+    const struct ais_field_t *fields;
+    size_t nfields;
+};
+
+/* layout of a fixed-format message type, or NULL if it has none */
+const struct ais_layout_t *ais_layout(unsigned int type);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef AIS_POSITION_H_
+#define AIS_POSITION_H_
+
+/*
+ * Compact position record, an alternative decode target to struct ais_t
+ * for the position reports (types 1-3, 18, 19 and 27).
+ *
+ * A record is 32 bytes with every member naturally aligned, so arrays of
+ * them can be kept in bulk, copied between threads or viewed from other
+ * languages without packing pragmas. Units are the same for every type:
+ * type 27's coarser values are scaled up, and its "not available" values
+ * mapped to the type 1 ones.
+ */
+
+#include <stdint.h>
+
+#define AIS_POSITION_ACCURACY	0x01	/* high position accuracy */
+#define AIS_POSITION_RAIM	0x02	/* RAIM in use */
+#define AIS_POSITION_ASSIGNED	0x04	/* assigned mode (types 18, 19) */
+#define AIS_POSITION_CS		0x08	/* carrier-sense unit (type 18) */
+#define AIS_POSITION_GNSS	0x10	/* ais_t type27.gnss (type 27) */
+
+#define AIS_POSITION_NO_STATUS	15	/* "not defined", for class B */
+
+struct ais_position_t {
+    uint32_t mmsi;		/* MMSI */
+    int32_t lat;		/* latitude, 1/10000 minute */
+    int32_t lon;		/* longitude, 1/10000 minute */
+    uint16_t speed;		/* speed over ground, deciknots */
+    uint16_t course;		/* course over ground, decidegrees */
+    uint16_t heading;		/* true heading, degrees */
+    uint8_t type;		/* message type */
+    uint8_t status;		/* navigation status, 15 for class B */
+    uint8_t second;		/* seconds of UTC timestamp, 60 if not available */
+    int8_t turn;		/* rate of turn, -128 if not available */
+    uint8_t flags;		/* AIS_POSITION_* */
+    uint8_t repeat;		/* repeat indicator */
+    uint32_t radio;		/* radio status bits, 0 for types 19, 27 */
+    uint32_t reserved;
+};
+
+#endif
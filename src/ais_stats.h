@@ -0,0 +1,63 @@
+#ifndef AIS_STATS_H_
+#define AIS_STATS_H_
+
+/*
+ * Decoder statistics, kept per session by aivdm_decode() and
+ * aivdm_decode_position(). Counting is a few increments per sentence;
+ * decode times are only taken for one sentence in AIS_TIMING_SAMPLE, so
+ * the clock reads cost little on average.
+ */
+
+#define AIS_STATS_TYPES		64	/* every 6-bit message type */
+#define AIS_TIMING_SAMPLE	64	/* sentences per timed sentence */
+#define AIS_TIME_BUCKETS	16	/* decode time histogram buckets */
+
+/*
+ * Reasons for rejecting a sentence before it was assembled into a
+ * message, with their names.
+ */
+#define AIS_REJECTS(X) \
+    X(OVERLONG, "overlong")	/* longer than any valid sentence */ \
+    X(CHECKSUM, "checksum")	/* bad checksum, if verified */ \
+    X(MALFORMED, "malformed")	/* too few fields */ \
+    X(CHANNEL, "channel")	/* channel C, or not a channel */ \
+    X(FRAGMENT, "fragment")	/* fragment numbers out of range */ \
+    X(PAYLOAD, "payload")	/* payload too long for a message */ \
+    X(FILTERED, "filtered")	/* message type not selected */ \
+    X(TAGBLOCK, "tagblock")	/* bad checksum or unterminated tag block */
+
+#define AIS_REJECT_ENUM(NAME, name)	AIS_REJECT_##NAME,
+enum ais_reject_t {
+    AIS_REJECTS(AIS_REJECT_ENUM)
+    AIS_REJECT_REASONS
+};
+#undef AIS_REJECT_ENUM
+
+struct ais_reassembly_stats_t {
+    unsigned long completed;	/* multipart messages completed */
+    unsigned long expired;	/* incomplete messages timed out */
+    unsigned long evicted;	/* incomplete messages dropped to make room */
+    unsigned long dropped;	/* fragments which never completed a message */
+};
+
+struct ais_stats_t {
+    unsigned long sentences;	/* sentences passed in */
+    unsigned long rejected[AIS_REJECT_REASONS];
+    /*
+     * Assembled messages by type: decoded, or not (too short, unsupported,
+     * not a position report for a position record, or a type 24 part
+     * waiting for its other half).
+     */
+    unsigned long decoded[AIS_STATS_TYPES];
+    unsigned long undecoded[AIS_STATS_TYPES];
+    struct ais_reassembly_stats_t reassembly;
+    /*
+     * Sampled decode times: bucket 0 counts sentences taking under 64 ns,
+     * bucket i from 2^(i+5) ns, and the last one everything longer.
+     */
+    unsigned long timed;
+    unsigned long long timed_nsec;
+    unsigned long time_histogram[AIS_TIME_BUCKETS];
+};
+
+#endif
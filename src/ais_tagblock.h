@@ -0,0 +1,33 @@
+#ifndef AIS_TAGBLOCK_H_
+#define AIS_TAGBLOCK_H_
+
+/*
+ * The NMEA 4.0 tag block a sentence may be prefixed with, as in
+ *
+ *   \g:1-2-73874,s:station1,c:1700000000*5A\!AIVDM,...
+ *
+ * Of its fields, the receive time (c), source (s) and sentence grouping
+ * (g) are kept; others are skipped. The source is not copied: it points
+ * into the sentence passed in, except when it is carried over from the
+ * first sentence of a group to later ones without their own.
+ */
+
+#include <stddef.h>
+
+#define AIS_TAG_TIME	0x01	/* c: */
+#define AIS_TAG_SOURCE	0x02	/* s: */
+#define AIS_TAG_GROUP	0x04	/* g: */
+
+#define AIS_TAG_SOURCE_MAX	15	/* the longest source ID kept for a group */
+
+struct ais_tagblock_t {
+    unsigned int fields;	/* AIS_TAG_* bits of the fields present */
+    long long time;		/* UNIX time as sent, seconds by the standard */
+    const char *source;		/* station or receiver ID, not NUL-terminated */
+    size_t source_len;
+    unsigned int group_sentence;	/* number of this sentence in the group */
+    unsigned int group_count;	/* sentences in the group */
+    unsigned int group_id;
+};
+
+#endif
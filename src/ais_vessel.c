@@ -0,0 +1,465 @@
+/*
+ * Vessel table: last known state of vessels, by MMSI.
+ *
+ * The records are kept densely in one array, so snapshots are copies of
+ * a contiguous block; removing a record moves the last one into its
+ * place. An open-addressing hash table with linear probing maps MMSIs to
+ * their index in the array. Its slots hold the MMSI too, so probing
+ * touches no record, and it is sized to be at most 3/4 full.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "ais_layout.h"
+#include "ais_vessel.h"
+
+struct ais_vessel_slot_t {
+    uint32_t mmsi;		/* 0 if the slot is empty */
+    uint32_t index;		/* of the record in vessels */
+};
+
+struct ais_vessel_table_t {
+    struct ais_vessel_slot_t *slots;
+    uint32_t mask;		/* number of slots - 1, a power of 2 - 1 */
+    unsigned int shift;		/* 32 - log2(number of slots) */
+    struct ais_vessel_t *vessels;
+    size_t count, capacity;
+    uint64_t updates;
+};
+
+static uint32_t vessel_hash(const struct ais_vessel_table_t *table,
+			    uint32_t mmsi)
+/* Fibonacci hashing; MMSIs share their leading digits by country */
+{
+    return (uint32_t)(mmsi * 2654435769u) >> table->shift;
+}
+
+static struct ais_vessel_slot_t *vessel_slot(const struct ais_vessel_table_t *table,
+					     uint32_t mmsi)
+/* the slot of mmsi, or the empty slot where it would go */
+{
+    uint32_t i = vessel_hash(table, mmsi);
+
+    while (table->slots[i].mmsi != 0 && table->slots[i].mmsi != mmsi)
+	i = (i + 1) & table->mask;
+    return &table->slots[i];
+}
+
+struct ais_vessel_table_t *ais_vessel_table_create(size_t capacity)
+{
+    struct ais_vessel_table_t *table;
+    size_t slots = 16;
+    unsigned int bits = 4;
+
+    if (capacity == 0 || capacity > AIS_VESSEL_MAX_CAPACITY)
+	return NULL;
+    while (slots < capacity + capacity / 3 + 1) {
+	slots *= 2;
+	bits++;
+    }
+    table = calloc(1, sizeof(*table));
+    if (table == NULL)
+	return NULL;
+    table->slots = calloc(slots, sizeof(*table->slots));
+    table->vessels = malloc(capacity * sizeof(*table->vessels));
+    if (table->slots == NULL || table->vessels == NULL) {
+	ais_vessel_table_destroy(table);
+	return NULL;
+    }
+    table->mask = (uint32_t)(slots - 1);
+    table->shift = 32 - bits;
+    table->capacity = capacity;
+    return table;
+}
+
+void ais_vessel_table_destroy(struct ais_vessel_table_t *table)
+{
+    if (table == NULL)
+	return;
+    free(table->slots);
+    free(table->vessels);
+    free(table);
+}
+
+static struct ais_vessel_t *vessel_record(struct ais_vessel_table_t *table,
+					  uint32_t mmsi)
+/* the record of mmsi, added if new; NULL if there is no room */
+{
+    struct ais_vessel_slot_t *slot;
+    struct ais_vessel_t *vessel;
+
+    /* MMSI 0 marks empty slots, and is no vessel's anyway */
+    if (mmsi == 0)
+	return NULL;
+    slot = vessel_slot(table, mmsi);
+    if (slot->mmsi == mmsi)
+	vessel = &table->vessels[slot->index];
+    else {
+	if (table->count == table->capacity)
+	    return NULL;
+	slot->mmsi = mmsi;
+	slot->index = (uint32_t)table->count;
+	vessel = &table->vessels[table->count++];
+	(void)memset(vessel, 0, sizeof(*vessel));
+	/* what position_keep() keeps of fields never received */
+	vessel->position.mmsi = mmsi;
+	vessel->position.status = AIS_POSITION_NO_STATUS;
+	vessel->position.turn = -128;
+	vessel->position.speed = AIS_SPEED_NOT_AVAILABLE;
+	vessel->position.lat = AIS_LAT_NOT_AVAILABLE;
+	vessel->position.lon = AIS_LON_NOT_AVAILABLE;
+	vessel->position.course = AIS_COURSE_NOT_AVAILABLE;
+	vessel->position.heading = AIS_HEADING_NOT_AVAILABLE;
+	vessel->position.second = AIS_SEC_NOT_AVAILABLE;
+    }
+    vessel->updated = ++table->updates;
+    return vessel;
+}
+
+static void vessel_position(struct ais_vessel_t *vessel,
+			    const struct ais_position_t *pos)
+{
+    int32_t lat = vessel->position.lat, lon = vessel->position.lon;
+
+    vessel->position = *pos;
+    if (pos->lat == AIS_LAT_NOT_AVAILABLE || pos->lon == AIS_LON_NOT_AVAILABLE) {
+	vessel->position.lat = lat;
+	vessel->position.lon = lon;
+    }
+}
+
+static bool position_from(const struct ais_t *ais, struct ais_position_t *pos)
+/* the position report in ais as a compact record, as ais_position_decode() does */
+{
+#define FLAG(cond, flag)	((cond) ? (flag) : 0)
+    (void)memset(pos, 0, sizeof(*pos));
+    pos->type = (uint8_t)ais->type;
+    pos->repeat = (uint8_t)ais->repeat;
+    pos->mmsi = ais->mmsi;
+
+    /* *INDENT-OFF* */
+    switch (ais->type) {
+    case 1:	/* Position Report */
+    case 2:
+    case 3:
+	pos->status	= (uint8_t)ais->type1.status;
+	pos->turn	= (int8_t)ais->type1.turn;
+	pos->speed	= (uint16_t)ais->type1.speed;
+	pos->lon	= ais->type1.lon;
+	pos->lat	= ais->type1.lat;
+	pos->course	= (uint16_t)ais->type1.course;
+	pos->heading	= (uint16_t)ais->type1.heading;
+	pos->second	= (uint8_t)ais->type1.second;
+	pos->radio	= ais->type1.radio;
+	pos->flags	= FLAG(ais->type1.accuracy, AIS_POSITION_ACCURACY)
+			| FLAG(ais->type1.raim, AIS_POSITION_RAIM);
+	break;
+    case 18:	/* Standard Class B CS Position Report */
+	pos->status	= AIS_POSITION_NO_STATUS;
+	pos->turn	= -128;
+	pos->speed	= (uint16_t)ais->type18.speed;
+	pos->lon	= ais->type18.lon;
+	pos->lat	= ais->type18.lat;
+	pos->course	= (uint16_t)ais->type18.course;
+	pos->heading	= (uint16_t)ais->type18.heading;
+	pos->second	= (uint8_t)ais->type18.second;
+	pos->radio	= ais->type18.radio;
+	pos->flags	= FLAG(ais->type18.accuracy, AIS_POSITION_ACCURACY)
+			| FLAG(ais->type18.raim, AIS_POSITION_RAIM)
+			| FLAG(ais->type18.assigned, AIS_POSITION_ASSIGNED)
+			| FLAG(ais->type18.cs, AIS_POSITION_CS);
+	break;
+    case 19:	/* Extended Class B CS Position Report */
+	pos->status	= AIS_POSITION_NO_STATUS;
+	pos->turn	= -128;
+	pos->speed	= (uint16_t)ais->type19.speed;
+	pos->lon	= ais->type19.lon;
+	pos->lat	= ais->type19.lat;
+	pos->course	= (uint16_t)ais->type19.course;
+	pos->heading	= (uint16_t)ais->type19.heading;
+	pos->second	= (uint8_t)ais->type19.second;
+	pos->flags	= FLAG(ais->type19.accuracy, AIS_POSITION_ACCURACY)
+			| FLAG(ais->type19.raim, AIS_POSITION_RAIM)
+			| FLAG(ais->type19.assigned, AIS_POSITION_ASSIGNED);
+	break;
+    case 27:	/* Long Range AIS Broadcast message */
+	/* scale to the type 1 units; not-available values map across */
+	pos->status	= (uint8_t)ais->type27.status;
+	pos->turn	= -128;
+	pos->lon	= ais->type27.lon * 1000;
+	pos->lat	= ais->type27.lat * 1000;
+	pos->speed	= ais->type27.speed == AIS_LONGRANGE_SPEED_NOT_AVAILABLE
+			? AIS_SPEED_NOT_AVAILABLE : (uint16_t)(ais->type27.speed * 10);
+	pos->course	= ais->type27.course == AIS_LONGRANGE_COURSE_NOT_AVAILABLE
+			? AIS_COURSE_NOT_AVAILABLE : (uint16_t)(ais->type27.course * 10);
+	pos->heading	= AIS_HEADING_NOT_AVAILABLE;
+	pos->second	= AIS_SEC_NOT_AVAILABLE;
+	pos->flags	= FLAG(ais->type27.accuracy, AIS_POSITION_ACCURACY)
+			| FLAG(ais->type27.raim, AIS_POSITION_RAIM)
+			| FLAG(ais->type27.gnss, AIS_POSITION_GNSS);
+	break;
+    default:
+	return false;
+    }
+    /* *INDENT-ON* */
+#undef FLAG
+    return true;
+}
+
+static void position_keep(struct ais_position_t *pos,
+			  const struct ais_position_t *old, uint32_t skip)
+/* keep the members of old whose fields were left out of the message */
+{
+#define KEEP(group, member, field) \
+    if ((skip & AIS_FIELD_BIT(group, member)) != 0) \
+	pos->field = old->field
+#define KEEP_FLAG(group, member, flag) \
+    if ((skip & AIS_FIELD_BIT(group, member)) != 0) \
+	pos->flags = (uint8_t)((pos->flags & ~(flag)) | (old->flags & (flag)))
+
+    /* *INDENT-OFF* */
+    switch (pos->type) {
+    case 1:	/* Position Report */
+    case 2:
+    case 3:
+	KEEP(type1, status, status);
+	KEEP(type1, turn, turn);
+	KEEP(type1, speed, speed);
+	KEEP(type1, lon, lon);
+	KEEP(type1, lat, lat);
+	KEEP(type1, course, course);
+	KEEP(type1, heading, heading);
+	KEEP(type1, second, second);
+	KEEP(type1, radio, radio);
+	KEEP_FLAG(type1, accuracy, AIS_POSITION_ACCURACY);
+	KEEP_FLAG(type1, raim, AIS_POSITION_RAIM);
+	break;
+    case 18:	/* Standard Class B CS Position Report */
+	KEEP(type18, speed, speed);
+	KEEP(type18, lon, lon);
+	KEEP(type18, lat, lat);
+	KEEP(type18, course, course);
+	KEEP(type18, heading, heading);
+	KEEP(type18, second, second);
+	KEEP(type18, radio, radio);
+	KEEP_FLAG(type18, accuracy, AIS_POSITION_ACCURACY);
+	KEEP_FLAG(type18, raim, AIS_POSITION_RAIM);
+	KEEP_FLAG(type18, assigned, AIS_POSITION_ASSIGNED);
+	KEEP_FLAG(type18, cs, AIS_POSITION_CS);
+	break;
+    case 19:	/* Extended Class B CS Position Report */
+	KEEP(type19, speed, speed);
+	KEEP(type19, lon, lon);
+	KEEP(type19, lat, lat);
+	KEEP(type19, course, course);
+	KEEP(type19, heading, heading);
+	KEEP(type19, second, second);
+	KEEP_FLAG(type19, accuracy, AIS_POSITION_ACCURACY);
+	KEEP_FLAG(type19, raim, AIS_POSITION_RAIM);
+	KEEP_FLAG(type19, assigned, AIS_POSITION_ASSIGNED);
+	break;
+    case 27:	/* Long Range AIS Broadcast message */
+	KEEP(type27, status, status);
+	KEEP(type27, lon, lon);
+	KEEP(type27, lat, lat);
+	KEEP(type27, speed, speed);
+	KEEP(type27, course, course);
+	KEEP_FLAG(type27, accuracy, AIS_POSITION_ACCURACY);
+	KEEP_FLAG(type27, raim, AIS_POSITION_RAIM);
+	KEEP_FLAG(type27, gnss, AIS_POSITION_GNSS);
+	break;
+    }
+    /* *INDENT-ON* */
+#undef KEEP
+#undef KEEP_FLAG
+}
+
+bool ais_vessel_update_position(struct ais_vessel_table_t *table,
+				const struct ais_position_t *pos)
+{
+    struct ais_vessel_t *vessel = vessel_record(table, pos->mmsi);
+
+    if (vessel == NULL)
+	return false;
+    vessel_position(vessel, pos);
+    return true;
+}
+
+bool ais_vessel_update(struct ais_vessel_table_t *table,
+		       const struct ais_t *ais, const uint32_t *skip_fields)
+{
+    struct ais_position_t pos;
+    struct ais_vessel_t *vessel;
+    bool moving = position_from(ais, &pos);
+    uint32_t skip = 0;
+
+    if (!moving && ais->type != 5 && ais->type != 24)
+	return false;
+    vessel = vessel_record(table, ais->mmsi);
+    if (vessel == NULL)
+	return false;
+    if (skip_fields != NULL && ais->type < AIS_MESSAGE_TYPES)
+	skip = skip_fields[ais->type];
+    if (moving) {
+	if (skip != 0)
+	    position_keep(&pos, &vessel->position, skip);
+	vessel_position(vessel, &pos);
+    }
+
+/* merge a layout field unless it was left out of the message */
+#define WANT(group, member)	((skip & AIS_FIELD_BIT(group, member)) == 0)
+#define MERGE(group, member, field) \
+    if (WANT(group, member)) \
+	vessel->field = (uint8_t)ais->group.member
+#define MERGE_TEXT(group, member, field) \
+    if (WANT(group, member)) \
+	(void)memcpy(vessel->field, ais->group.member, sizeof(vessel->field))
+
+    switch (ais->type) {
+    case 5:	/* Ship static and voyage related data */
+	if (WANT(type5, imo))
+	    vessel->imo = ais->type5.imo;
+	MERGE_TEXT(type5, callsign, callsign);
+	MERGE_TEXT(type5, shipname, shipname);
+	MERGE_TEXT(type5, destination, destination);
+	MERGE(type5, shiptype, shiptype);
+	if (WANT(type5, to_bow))
+	    vessel->to_bow = (uint16_t)ais->type5.to_bow;
+	if (WANT(type5, to_stern))
+	    vessel->to_stern = (uint16_t)ais->type5.to_stern;
+	MERGE(type5, to_port, to_port);
+	MERGE(type5, to_starboard, to_starboard);
+	MERGE(type5, epfd, epfd);
+	MERGE(type5, month, eta_month);
+	MERGE(type5, day, eta_day);
+	MERGE(type5, hour, eta_hour);
+	MERGE(type5, minute, eta_minute);
+	MERGE(type5, draught, draught);
+	break;
+    case 19:	/* Extended Class B CS Position Report */
+	MERGE_TEXT(type19, shipname, shipname);
+	MERGE(type19, shiptype, shiptype);
+	if (WANT(type19, to_bow))
+	    vessel->to_bow = (uint16_t)ais->type19.to_bow;
+	if (WANT(type19, to_stern))
+	    vessel->to_stern = (uint16_t)ais->type19.to_stern;
+	MERGE(type19, to_port, to_port);
+	MERGE(type19, to_starboard, to_starboard);
+	MERGE(type19, epfd, epfd);
+	break;
+    case 24:	/* Class B CS Static Data Report, either part or both */
+	/* no layout, so always decoded in full */
+	if (ais->type24.part != part_b)
+	    (void)memcpy(vessel->shipname, ais->type24.shipname,
+			 sizeof(vessel->shipname));
+	if (ais->type24.part != part_a) {
+	    vessel->shiptype = (uint8_t)ais->type24.shiptype;
+	    (void)memcpy(vessel->callsign, ais->type24.callsign,
+			 sizeof(vessel->callsign));
+	    /* auxiliary craft send their mother ship's MMSI instead */
+	    if (!AIS_AUXILIARY_MMSI(ais->mmsi)) {
+		vessel->to_bow = (uint16_t)ais->type24.dim.to_bow;
+		vessel->to_stern = (uint16_t)ais->type24.dim.to_stern;
+		vessel->to_port = (uint8_t)ais->type24.dim.to_port;
+		vessel->to_starboard = (uint8_t)ais->type24.dim.to_starboard;
+	    }
+	}
+	break;
+    default:
+	return true;
+    }
+#undef WANT
+#undef MERGE
+#undef MERGE_TEXT
+    vessel->static_type = (uint8_t)ais->type;
+    return true;
+}
+
+bool ais_vessel_get(const struct ais_vessel_table_t *table,
+		    uint32_t mmsi, struct ais_vessel_t *vessel)
+{
+    const struct ais_vessel_slot_t *slot;
+
+    if (mmsi == 0)
+	return false;
+    slot = vessel_slot(table, mmsi);
+    if (slot->mmsi != mmsi)
+	return false;
+    *vessel = table->vessels[slot->index];
+    return true;
+}
+
+size_t ais_vessel_snapshot(const struct ais_vessel_table_t *table,
+			   uint64_t since,
+			   struct ais_vessel_t *vessels, size_t max)
+{
+    size_t i, n = 0;
+
+    if (since == 0) {
+	n = table->count < max ? table->count : max;
+	(void)memcpy(vessels, table->vessels, n * sizeof(*vessels));
+	return n;
+    }
+    for (i = 0; i < table->count && n < max; i++)
+	if (table->vessels[i].updated > since)
+	    vessels[n++] = table->vessels[i];
+    return n;
+}
+
+size_t ais_vessel_count(const struct ais_vessel_table_t *table)
+{
+    return table->count;
+}
+
+uint64_t ais_vessel_updates(const struct ais_vessel_table_t *table)
+{
+    return table->updates;
+}
+
+static void vessel_remove(struct ais_vessel_table_t *table, size_t index)
+/* remove a record, moving the last one into its place */
+{
+    struct ais_vessel_slot_t *slot =
+	vessel_slot(table, table->vessels[index].position.mmsi);
+    uint32_t hole = (uint32_t)(slot - table->slots), i = hole;
+    size_t last = table->count - 1;
+
+    /*
+     * Empty the slot without breaking the probe sequences running
+     * through it: shift back every later entry of the run which may
+     * live in the hole, i.e. whose home slot isn't between hole and it.
+     */
+    for (;;) {
+	uint32_t home;
+
+	i = (i + 1) & table->mask;
+	if (table->slots[i].mmsi == 0)
+	    break;
+	home = vessel_hash(table, table->slots[i].mmsi);
+	if (((i - home) & table->mask) >= ((i - hole) & table->mask)) {
+	    table->slots[hole] = table->slots[i];
+	    hole = i;
+	}
+    }
+    table->slots[hole].mmsi = 0;
+
+    if (index != last) {
+	table->vessels[index] = table->vessels[last];
+	vessel_slot(table, table->vessels[index].position.mmsi)->index =
+	    (uint32_t)index;
+    }
+    table->count--;
+}
+
+size_t ais_vessel_expire(struct ais_vessel_table_t *table, uint64_t since)
+{
+    size_t i = 0, removed = 0;
+
+    while (i < table->count)
+	if (table->vessels[i].updated <= since) {
+	    vessel_remove(table, i);
+	    removed++;
+	} else
+	    i++;
+    return removed;
+}
@@ -0,0 +1,96 @@
+#ifndef AIS_VESSEL_H_
+#define AIS_VESSEL_H_
+
+/*
+ * Last known state of vessels, by MMSI.
+ *
+ * A vessel table merges the position reports (types 1-3, 18, 19 and 27)
+ * of each vessel with its static and voyage data (types 5, 19 and 24),
+ * one fixed-size record per vessel. All memory is allocated when the
+ * table is created for a given number of vessels; updates take constant
+ * time and never allocate. Once the table is full, messages from further
+ * vessels are ignored until others are expired.
+ *
+ * A table is not locked; it must not be updated and read concurrently.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ais.h"
+#include "ais_position.h"
+
+#define AIS_VESSEL_MAX_CAPACITY	(1u << 28)
+
+struct ais_vessel_t {
+    /*
+     * The last position report; its mmsi is always the vessel's, and its
+     * type 0 until a position report comes in. A report without a
+     * position leaves the last known lat and lon.
+     */
+    struct ais_position_t position;
+    uint64_t updated;		/* update number of the last message */
+    uint32_t imo;		/* IMO number, 0 if not known */
+    uint16_t to_bow;		/* dimensions, meters */
+    uint16_t to_stern;
+    uint8_t to_port;
+    uint8_t to_starboard;
+    uint8_t shiptype;		/* ship type code */
+    uint8_t epfd;		/* type of position fix device */
+    uint8_t draught;		/* 1/10 meters */
+    uint8_t eta_month;		/* estimated time of arrival, UTC */
+    uint8_t eta_day;
+    uint8_t eta_hour;
+    uint8_t eta_minute;
+    uint8_t static_type;	/* last static data message, 5, 19 or 24 */
+    char callsign[8];
+    char shipname[AIS_SHIPNAME_MAXLEN + 1];
+    char destination[20 + 1];
+    uint8_t reserved[4];
+};
+
+struct ais_vessel_table_t;
+
+/* a table with room for capacity vessels, or NULL */
+extern struct ais_vessel_table_t *ais_vessel_table_create(size_t capacity);
+extern void ais_vessel_table_destroy(struct ais_vessel_table_t *table);
+
+/*
+ * Merge a decoded message into the record of its vessel. Returns false
+ * for messages of other types, and for new vessels if the table is full.
+ * skip_fields, if not NULL, holds per message type the layout fields
+ * left out of the message (see ais_select_fields()); their members keep
+ * their last known values.
+ */
+extern bool ais_vessel_update(struct ais_vessel_table_t *table,
+			      const struct ais_t *ais,
+			      /*@null@*/const uint32_t *skip_fields);
+extern bool ais_vessel_update_position(struct ais_vessel_table_t *table,
+				       const struct ais_position_t *pos);
+
+/* copy the record of mmsi; false if there is none */
+extern bool ais_vessel_get(const struct ais_vessel_table_t *table,
+			   uint32_t mmsi, struct ais_vessel_t *vessel);
+
+/*
+ * Copy up to max records of the vessels updated after update number
+ * since (0 for all), in no particular order. Returns the number copied.
+ */
+extern size_t ais_vessel_snapshot(const struct ais_vessel_table_t *table,
+				  uint64_t since,
+				  struct ais_vessel_t *vessels, size_t max);
+
+extern size_t ais_vessel_count(const struct ais_vessel_table_t *table);
+
+/*
+ * Updates are numbered from 1, and each record keeps the number of its
+ * last one. ais_vessel_updates() is the number of the last update of the
+ * table; ais_vessel_expire() removes the vessels not updated after
+ * update number since, and returns how many.
+ */
+extern uint64_t ais_vessel_updates(const struct ais_vessel_table_t *table);
+extern size_t ais_vessel_expire(struct ais_vessel_table_t *table,
+				uint64_t since);
+
+#endif
@@ -2,14 +2,26 @@
 
 extern "C" {
   #include "aivdm_decode.h" // gps_device_t
+  #include "driver_ais.h" // ais_binary_encode()
 }
 
+#include <errno.h>
 #include <string.h>
+#include <vector>
 
-ais_handle_t *ais_create_handle()
+#ifndef _WIN32
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+ais_handle_t *ais_create_handle(void)
 {
   ais_handle_t *handle = new ais_handle_t;
   memset(&handle->driver.aivdm, 0, sizeof(handle->driver.aivdm));
+  handle->driver.aivdm.max_sentences = AIS_DEFAULT_MAX_SENTENCES;
   handle->context = new ais_handle_t::gps_context_t;
   
   return handle;
@@ -17,6 +29,7 @@ ais_handle_t *ais_create_handle()
 
 void ais_destroy_handle(ais_handle_t *handle)
 {
+  delete handle->context;
   delete handle;
 }
 
@@ -29,3 +42,536 @@ int ais_decode(ais_handle_t *handle,
   handle->context->debug = debug;
   return aivdm_decode(buf, buflen, handle, ais, split24, debug);
 }
+
+bool ais_get_tagblock(const ais_handle_t *handle, struct ais_tagblock_t *tag)
+{
+  *tag = handle->driver.aivdm.tagblock;
+  return tag->fields != 0;
+}
+
+int ais_decode_position(ais_handle_t *handle,
+                        const char *buf, size_t buflen,
+                        struct ais_position_t *pos,
+                        int debug)
+{
+  handle->context->debug = debug;
+  return aivdm_decode_position(buf, buflen, handle, pos);
+}
+
+void ais_set_source(ais_handle_t *handle, unsigned int source)
+{
+  handle->driver.aivdm.source = source;
+}
+
+void ais_set_reassembly_limits(ais_handle_t *handle,
+                               unsigned long max_sentences,
+                               unsigned long timeout_msec)
+{
+  handle->driver.aivdm.max_sentences = max_sentences;
+  handle->driver.aivdm.timeout_msec = timeout_msec;
+}
+
+void ais_get_reassembly_stats(const ais_handle_t *handle,
+                              struct ais_reassembly_stats_t *stats)
+{
+  *stats = handle->driver.aivdm.stats.reassembly;
+}
+
+void ais_set_verify_checksum(ais_handle_t *handle, bool verify)
+{
+  handle->driver.aivdm.verify_checksum = verify;
+}
+
+unsigned long ais_get_checksum_errors(const ais_handle_t *handle)
+{
+  return handle->driver.aivdm.stats.rejected[AIS_REJECT_CHECKSUM];
+}
+
+void ais_get_stats(const ais_handle_t *handle, struct ais_stats_t *stats)
+{
+  *stats = handle->driver.aivdm.stats;
+}
+
+void ais_reset_stats(ais_handle_t *handle)
+{
+  memset(&handle->driver.aivdm.stats, 0, sizeof(handle->driver.aivdm.stats));
+}
+
+void ais_add_stats(ais_handle_t *handle, const struct ais_stats_t *stats)
+{
+  struct ais_stats_t *to = &handle->driver.aivdm.stats;
+  to->sentences += stats->sentences;
+  for (int i = 0; i < AIS_REJECT_REASONS; i++) {
+    to->rejected[i] += stats->rejected[i];
+  }
+  for (int type = 0; type < AIS_STATS_TYPES; type++) {
+    to->decoded[type] += stats->decoded[type];
+    to->undecoded[type] += stats->undecoded[type];
+  }
+  to->reassembly.completed += stats->reassembly.completed;
+  to->reassembly.expired += stats->reassembly.expired;
+  to->reassembly.evicted += stats->reassembly.evicted;
+  to->reassembly.dropped += stats->reassembly.dropped;
+  to->timed += stats->timed;
+  to->timed_nsec += stats->timed_nsec;
+  for (int i = 0; i < AIS_TIME_BUCKETS; i++) {
+    to->time_histogram[i] += stats->time_histogram[i];
+  }
+}
+
+void ais_set_log_callback(ais_log_callback_t callback, void *userdata)
+{
+  gpsd_set_log_hook(callback, userdata);
+}
+
+void ais_select_fields(ais_handle_t *handle, unsigned int type, uint32_t fields)
+{
+  if (type < AIS_MESSAGE_TYPES) {
+    handle->driver.aivdm.skip_fields[type] = ~fields;
+  }
+}
+
+void ais_select_types(ais_handle_t *handle, uint64_t types)
+{
+  handle->driver.aivdm.skip_types = ~types;
+}
+
+void ais_copy_settings(ais_handle_t *handle, const ais_handle_t *from)
+{
+  handle->driver.aivdm.source = from->driver.aivdm.source;
+  handle->driver.aivdm.max_sentences = from->driver.aivdm.max_sentences;
+  handle->driver.aivdm.timeout_msec = from->driver.aivdm.timeout_msec;
+  handle->driver.aivdm.verify_checksum = from->driver.aivdm.verify_checksum;
+  handle->driver.aivdm.skip_types = from->driver.aivdm.skip_types;
+  memcpy(handle->driver.aivdm.skip_fields, from->driver.aivdm.skip_fields,
+         sizeof(handle->driver.aivdm.skip_fields));
+}
+
+void ais_set_vessel_table(ais_handle_t *handle, struct ais_vessel_table_t *table)
+{
+  handle->driver.aivdm.vessels = table;
+}
+
+size_t ais_decode_lines(ais_handle_t *handle,
+                        const char *buf, size_t buflen,
+                        ais_callback_t callback, void *userdata,
+                        bool split24,
+                        int debug)
+{
+  const char *end = buf + buflen;
+  size_t count = 0;
+  while (buf < end) {
+    const char *eol = static_cast<const char *>(memchr(buf, '\n', end - buf));
+    if (!eol) eol = end;
+    size_t linelen = eol - buf;
+    if (linelen > 0 && buf[linelen - 1] == '\r') linelen--;
+    if (linelen > 0) {
+      struct ais_t ais;
+      if (ais_decode(handle, buf, linelen, &ais, split24, debug)) {
+        callback(&ais, userdata);
+        count++;
+      }
+    }
+    buf = eol < end ? eol + 1 : end;
+  }
+  return count;
+}
+
+size_t ais_decode_position_lines(ais_handle_t *handle,
+                                 const char *buf, size_t buflen,
+                                 struct ais_position_t *positions,
+                                 size_t maxpositions,
+                                 size_t *consumed,
+                                 int debug)
+{
+  const char *begin = buf;
+  const char *end = buf + buflen;
+  size_t count = 0;
+  while (buf < end && count < maxpositions) {
+    const char *eol = static_cast<const char *>(memchr(buf, '\n', end - buf));
+    if (!eol) eol = end;
+    size_t linelen = eol - buf;
+    if (linelen > 0 && buf[linelen - 1] == '\r') linelen--;
+    if (linelen > 0 &&
+        ais_decode_position(handle, buf, linelen, &positions[count], debug)) {
+      count++;
+    }
+    buf = eol < end ? eol + 1 : end;
+  }
+  if (consumed) *consumed = buf - begin;
+  return count;
+}
+
+static bool is_aivdm_sentence(const char *buf, size_t buflen)
+{
+  if (buflen > 0 && buf[0] == '\\') {
+    // Skip the tag block; aivdm_decode() validates it
+    const char *close = static_cast<const char *>(memchr(buf + 1, '\\', buflen - 1));
+    if (!close) return false;
+    buflen -= close + 1 - buf;
+    buf = close + 1;
+  }
+  return buflen >= 6 &&
+    (strncmp(buf, "!AIVDM", 6) == 0 || strncmp(buf, "!AIVDO", 6) == 0);
+}
+
+static bool follows_tagblock(const struct aivdm_stream_t *stream,
+                             const char *start, const char *cp)
+{
+  // A sentence spanning chunks starts in stream->buf
+  char prev = cp > start ? cp[-1] : stream->len > 0 ? stream->buf[stream->len - 1] : '\0';
+  return prev == '\\';
+}
+
+size_t ais_decode_stream(ais_handle_t *handle,
+                         const char *buf, size_t buflen,
+                         ais_callback_t callback, void *userdata,
+                         bool split24,
+                         int debug)
+{
+  struct aivdm_stream_t *stream = &handle->driver.aivdm.stream;
+  const char *end = buf + buflen;
+  size_t count = 0;
+  while (buf < end) {
+    const char *start = buf;
+    if (stream->len == 0) {
+      // Not inside a sentence: skip to the next start delimiter, '!' or
+      // the backslash opening a tag block
+      while (start < end && *start != '!' && *start != '\\') start++;
+      if (start == end) break;
+      buf = start + 1;
+    }
+
+    // A '!' right after the backslash closing a tag block is part of the
+    // sentence, not the start of another
+    const char *cp = buf;
+    while (cp < end && *cp != '\r' && *cp != '\n' &&
+           (*cp != '!' || follows_tagblock(stream, start, cp))) cp++;
+
+    if (cp == end) {
+      // Incomplete; carry it over to the next chunk. Overlong garbage is
+      // dropped, which makes us resynchronize on the next '!'.
+      size_t len = end - start;
+      if (stream->len + len <= sizeof(stream->buf)) {
+        memcpy(stream->buf + stream->len, start, len);
+        stream->len += len;
+      }
+      else {
+        stream->len = 0;
+      }
+      break;
+    }
+    if (*cp == '!') {
+      // A new sentence started before this one was terminated
+      stream->len = 0;
+      buf = cp;
+      continue;
+    }
+
+    // Complete sentence: decode in place unless it spans chunks
+    const char *sentence = start;
+    size_t len = cp - start;
+    if (stream->len > 0) {
+      if (stream->len + len <= sizeof(stream->buf)) {
+        memcpy(stream->buf + stream->len, start, len);
+        sentence = stream->buf;
+        len += stream->len;
+      }
+      else {
+        len = 0;
+      }
+      stream->len = 0;
+    }
+    if (is_aivdm_sentence(sentence, len)) {
+      struct ais_t ais;
+      if (ais_decode(handle, sentence, len, &ais, split24, debug)) {
+        callback(&ais, userdata);
+        count++;
+      }
+    }
+    buf = cp + 1;
+  }
+  return count;
+}
+
+#ifndef _WIN32
+/*!
+  A chunk of an ais_decode_file() input, in a ring of chunks being decoded
+  or waiting to be delivered.
+*/
+/*!
+  The tag block of the sentence completing a message of a chunk. A source
+  not in the file, carried over from its group, is copied to source and
+  tag.source left NULL until delivery.
+*/
+struct file_tag {
+  size_t message;
+  struct ais_tagblock_t tag;
+  char source[AIS_TAG_SOURCE_MAX];
+};
+
+struct file_chunk {
+  std::vector<ais_t> messages;
+  // Only for the messages which had one, in order
+  std::vector<file_tag> tags;
+  struct ais_stats_t stats;
+  bool done;
+};
+
+struct file_decode {
+  const ais_handle_t *settings;
+  const char *data;
+  size_t size;
+  size_t nchunks;
+  bool split24;
+  int debug;
+  // Guards next, delivered and the done flags
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  size_t next;
+  size_t delivered;
+  std::vector<file_chunk> ring;
+};
+
+// Where chunk i starts: after the first newline from its nominal start on
+static size_t chunk_start(const file_decode *fd, size_t i)
+{
+  if (i == 0) return 0;
+  if (i >= fd->nchunks) return fd->size;
+  size_t offset = i * AIS_FILE_CHUNK;
+  const char *nl = static_cast<const char *>(
+    memchr(fd->data + offset - 1, '\n', fd->size - offset + 1));
+  return nl ? nl - fd->data + 1 : fd->size;
+}
+
+// The start of the line n lines before the one starting at begin
+static const char *lines_before(const char *data, const char *begin, unsigned int n)
+{
+  const char *cp = begin;
+  while (n-- > 0 && cp > data) {
+    cp--;
+    while (cp > data && cp[-1] != '\n') cp--;
+  }
+  return cp;
+}
+
+static void ignore_message(const struct ais_t *, void *)
+{
+}
+
+// userdata for append_message()
+struct chunk_sink {
+  const file_decode *fd;
+  const ais_handle_t *handle;
+  file_chunk *chunk;
+};
+
+static void append_message(const struct ais_t *ais, void *userdata)
+{
+  chunk_sink *sink = static_cast<chunk_sink *>(userdata);
+  file_chunk *chunk = sink->chunk;
+  const struct ais_tagblock_t *tag = &sink->handle->driver.aivdm.tagblock;
+  if (tag->fields != 0) {
+    chunk->tags.resize(chunk->tags.size() + 1);
+    file_tag *entry = &chunk->tags.back();
+    entry->message = chunk->messages.size();
+    entry->tag = *tag;
+    const char *source = tag->source;
+    if (source && (source < sink->fd->data || source >= sink->fd->data + sink->fd->size)) {
+      memcpy(entry->source, source, tag->source_len);
+      entry->tag.source = NULL;
+    }
+  }
+  chunk->messages.push_back(*ais);
+}
+
+static void decode_chunk(const file_decode *fd, size_t i,
+                         ais_handle_t *handle, file_chunk *chunk)
+{
+  const char *begin = fd->data + chunk_start(fd, i);
+  const char *end = fd->data + chunk_start(fd, i + 1);
+  const char *primer = lines_before(fd->data, begin, AIS_FILE_OVERLAP);
+
+  memset(&handle->driver.aivdm, 0, sizeof(handle->driver.aivdm));
+  ais_copy_settings(handle, fd->settings);
+  chunk->messages.clear();
+  chunk->tags.clear();
+  chunk_sink sink = { fd, handle, chunk };
+  // The previous chunk's worker counts and delivers what these complete.
+  // Fragments at the start of the primer may be the rest of messages
+  // begun before it, and mustn't be joined to the next ones to come.
+  handle->driver.aivdm.in_order = true;
+  ais_decode_lines(handle, primer, begin - primer, ignore_message, NULL,
+                   fd->split24, fd->debug);
+  handle->driver.aivdm.in_order = false;
+  ais_reset_stats(handle);
+  // The next chunk is primed with the lines from tail on, so fragments
+  // left over from before tail are never completed
+  const char *tail = lines_before(begin, end, AIS_FILE_OVERLAP);
+  ais_decode_lines(handle, begin, tail - begin, append_message, &sink,
+                   fd->split24, fd->debug);
+  unsigned long stamp = handle->driver.aivdm.sentences;
+  ais_decode_lines(handle, tail, end - tail, append_message, &sink,
+                   fd->split24, fd->debug);
+  aivdm_flush(handle, stamp);
+  ais_get_stats(handle, &chunk->stats);
+}
+
+static void *decode_chunks(void *arg)
+{
+  file_decode *fd = static_cast<file_decode *>(arg);
+  ais_handle_t *handle = ais_create_handle();
+  for (;;) {
+    // Stay within the ring, so memory use is bounded however far behind
+    // the callback falls
+    pthread_mutex_lock(&fd->mutex);
+    while (fd->next < fd->nchunks && fd->next >= fd->delivered + fd->ring.size()) {
+      pthread_cond_wait(&fd->cond, &fd->mutex);
+    }
+    if (fd->next >= fd->nchunks) {
+      pthread_mutex_unlock(&fd->mutex);
+      break;
+    }
+    size_t i = fd->next++;
+    pthread_mutex_unlock(&fd->mutex);
+
+    file_chunk *chunk = &fd->ring[i % fd->ring.size()];
+    decode_chunk(fd, i, handle, chunk);
+
+    pthread_mutex_lock(&fd->mutex);
+    chunk->done = true;
+    pthread_cond_broadcast(&fd->cond);
+    pthread_mutex_unlock(&fd->mutex);
+  }
+  ais_destroy_handle(handle);
+  return NULL;
+}
+#endif
+
+long ais_decode_file(ais_handle_t *handle, const char *path,
+                     unsigned int threads,
+                     ais_callback_t callback, void *userdata,
+                     bool split24,
+                     int debug)
+{
+#ifdef _WIN32
+  errno = ENOSYS;
+  return -1;
+#else
+  int fdes = open(path, O_RDONLY);
+  if (fdes < 0) return -1;
+  struct stat st;
+  if (fstat(fdes, &st) < 0) {
+    int error = errno;
+    close(fdes);
+    errno = error;
+    return -1;
+  }
+  size_t size = st.st_size;
+  if (size == 0) {
+    close(fdes);
+    return 0;
+  }
+  void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fdes, 0);
+  int error = errno;
+  close(fdes);
+  if (map == MAP_FAILED) {
+    errno = error;
+    return -1;
+  }
+#ifdef MADV_SEQUENTIAL
+  madvise(map, size, MADV_SEQUENTIAL);
+#endif
+
+  file_decode fd;
+  fd.settings = handle;
+  fd.data = static_cast<const char *>(map);
+  fd.size = size;
+  fd.nchunks = (size + AIS_FILE_CHUNK - 1) / AIS_FILE_CHUNK;
+  fd.split24 = split24;
+  fd.debug = debug;
+  fd.next = 0;
+  fd.delivered = 0;
+  pthread_mutex_init(&fd.mutex, NULL);
+  pthread_cond_init(&fd.cond, NULL);
+
+  if (threads == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cpus > 0 ? cpus : 1;
+  }
+  if (threads > fd.nchunks) threads = fd.nchunks;
+  fd.ring.resize(2 * threads);
+  for (size_t i = 0; i < fd.ring.size(); i++) fd.ring[i].done = false;
+
+  std::vector<pthread_t> workers;
+  for (unsigned int t = 0; t < threads; t++) {
+    pthread_t worker;
+    if (pthread_create(&worker, NULL, decode_chunks, &fd) == 0) {
+      workers.push_back(worker);
+    }
+  }
+
+  long count = 0;
+  if (workers.empty()) {
+    count = -1;
+    error = EAGAIN;
+  }
+  else {
+    handle->context->debug = debug;
+    for (size_t i = 0; i < fd.nchunks; i++) {
+      file_chunk *chunk = &fd.ring[i % fd.ring.size()];
+      pthread_mutex_lock(&fd.mutex);
+      while (!chunk->done) pthread_cond_wait(&fd.cond, &fd.mutex);
+      pthread_mutex_unlock(&fd.mutex);
+
+      size_t t = 0;
+      for (size_t m = 0; m < chunk->messages.size(); m++) {
+        if (handle->driver.aivdm.vessels) {
+          ais_vessel_update(handle->driver.aivdm.vessels, &chunk->messages[m],
+                            handle->driver.aivdm.skip_fields);
+        }
+        // For ais_get_tagblock() from the callback
+        struct ais_tagblock_t *tag = &handle->driver.aivdm.tagblock;
+        if (t < chunk->tags.size() && chunk->tags[t].message == m) {
+          file_tag *entry = &chunk->tags[t++];
+          *tag = entry->tag;
+          if (tag->fields & AIS_TAG_SOURCE && !tag->source) tag->source = entry->source;
+        }
+        else {
+          tag->fields = 0;
+        }
+        callback(&chunk->messages[m], userdata);
+      }
+      count += chunk->messages.size();
+      ais_add_stats(handle, &chunk->stats);
+
+      pthread_mutex_lock(&fd.mutex);
+      chunk->done = false;
+      fd.delivered++;
+      pthread_cond_broadcast(&fd.cond);
+      pthread_mutex_unlock(&fd.mutex);
+    }
+  }
+
+  // Its source pointed into the file
+  memset(&handle->driver.aivdm.tagblock, 0, sizeof(handle->driver.aivdm.tagblock));
+  for (size_t t = 0; t < workers.size(); t++) pthread_join(workers[t], NULL);
+  pthread_cond_destroy(&fd.cond);
+  pthread_mutex_destroy(&fd.mutex);
+  munmap(map, size);
+  if (count < 0) errno = error;
+  return count;
+#endif
+}
+
+size_t ais_encode(const struct ais_t *ais, char channel, unsigned int seqid,
+                  char *buf, size_t buflen)
+{
+  unsigned char bits[AIS_ENCODE_BYTES];
+  size_t bitlen;
+
+  if (!ais_binary_encode(ais, bits, &bitlen)) {
+    return 0;
+  }
+  return aivdm_armor(bits, bitlen, channel, seqid, buf, buflen);
+}
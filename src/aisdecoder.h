@@ -3,23 +3,246 @@
 
 /*!
   This is a C wrapper for AIS decoding functionality extracted from the gpsd project
-  (http://www.catb.org/gpsd).
+  (http://www.catb.org/gpsd). It is usable from C and C++, and built into
+  libaisdecoder by `make lib` as well as into the node addon.
 */
 
 #include <stddef.h>
+#include <stdint.h>
+#ifdef __cplusplus
 extern "C" {
+#endif
 #include "ais.h"
+#include "ais_layout.h"
+#include "ais_position.h"
+#include "ais_stats.h"
+#include "ais_tagblock.h"
+#include "ais_vessel.h"
 #include "gpsd.h"
-}
 
 typedef struct gps_device_t ais_handle_t;
 
-ais_handle_t *ais_create_handle();
+ais_handle_t *ais_create_handle(void);
 void ais_destroy_handle(ais_handle_t *handle);
+/*!
+  Decodes the sentence in buf[0..buflen). buf doesn't need to be
+  NUL-terminated, so sentences can be decoded in place from a larger buffer.
+*/
 int ais_decode(ais_handle_t *handle,
                const char *buf, size_t buflen,
                struct ais_t *ais,
                bool split24, 
                int debug);
 
+/*!
+  Copies the NMEA 4.0 tag block of the last sentence decoded, e.g. the one
+  completing the message just returned by ais_decode() or passed to an
+  ais_decode_lines() callback, and returns whether it had one. Its source
+  points into that sentence, so it is only valid while the sentence is.
+  A sentence with a tag block that is unterminated or fails its checksum
+  is rejected.
+*/
+bool ais_get_tagblock(const ais_handle_t *handle, struct ais_tagblock_t *tag);
+
+/*!
+  Decodes the sentence in buf[0..buflen) like ais_decode(), but into a
+  compact position record. Completes only position reports (types 1-3,
+  18, 19 and 27); other messages are consumed and rejected.
+*/
+int ais_decode_position(ais_handle_t *handle,
+                        const char *buf, size_t buflen,
+                        struct ais_position_t *pos,
+                        int debug);
+
+/*!
+  Decodes newline-delimited sentences in buf[0..buflen) into the array
+  positions[0..maxpositions), like ais_decode_lines(). Stops after the line
+  completing the last record that fits, and stores the number of bytes
+  consumed in *consumed (if not NULL), so the rest can be decoded by
+  another call. Returns the number of records written.
+*/
+size_t ais_decode_position_lines(ais_handle_t *handle,
+                                 const char *buf, size_t buflen,
+                                 struct ais_position_t *positions,
+                                 size_t maxpositions,
+                                 size_t *consumed,
+                                 int debug);
+
+/*!
+  Sets the source of the sentences decoded from now on, e.g. the index of
+  the receiver or station they came from. Multipart messages are only
+  reassembled from fragments of the same source, so one handle can decode
+  a merged feed of many receivers. The source is 0 by default.
+*/
+void ais_set_source(ais_handle_t *handle, unsigned int source);
+
+/*!
+  Sets when incomplete multipart messages expire: after max_sentences
+  further sentences from their source, or timeout_msec milliseconds after
+  their first fragment arrived, whichever comes first. A limit of 0 is
+  never reached. Fragments of a message may arrive in any order until it
+  expires. By default messages expire after AIS_DEFAULT_MAX_SENTENCES,
+  with no timeout: enough for reordered fragments, but short of the next
+  message reusing the sequential message ID, which could otherwise be
+  joined to fragments left over after losses.
+*/
+#define AIS_DEFAULT_MAX_SENTENCES 8
+
+void ais_set_reassembly_limits(ais_handle_t *handle,
+                               unsigned long max_sentences,
+                               unsigned long timeout_msec);
+
+/*!
+  Counts of multipart messages completed, and of incomplete ones given up:
+  expired by ais_set_reassembly_limits(), or evicted to make room for
+  others. Fragments discarded that way, or as invalid or duplicate, are
+  counted in dropped. These are also part of ais_get_stats().
+*/
+void ais_get_reassembly_stats(const ais_handle_t *handle,
+                              struct ais_reassembly_stats_t *stats);
+
+/*!
+  Turns checking of the *hh checksum at the end of each sentence on or
+  off; it is off by default. When on, sentences with a missing or wrong
+  checksum are rejected before their fields are parsed, and counted in
+  ais_get_checksum_errors().
+*/
+void ais_set_verify_checksum(ais_handle_t *handle, bool verify);
+
+unsigned long ais_get_checksum_errors(const ais_handle_t *handle);
+
+/*!
+  Copies the statistics kept since the handle was created or
+  ais_reset_stats() was last called: sentences rejected by reason,
+  messages decoded and not decoded by type, reassembly counts and sampled
+  decode times (see ais_stats.h).
+*/
+void ais_get_stats(const ais_handle_t *handle, struct ais_stats_t *stats);
+void ais_reset_stats(ais_handle_t *handle);
+
+/*!
+  Adds stats to the statistics of handle, e.g. those of another handle
+  which decoded part of the same feed.
+*/
+void ais_add_stats(ais_handle_t *handle, const struct ais_stats_t *stats);
+
+/*!
+  Selects the fields to decode in messages of the given type. Bit i of
+  fields stands for field i of ais_layout(type) (see AIS_FIELD_BIT());
+  other layout fields are left zero. All fields are decoded by default,
+  and message types without a layout are always decoded in full.
+*/
+void ais_select_fields(ais_handle_t *handle, unsigned int type, uint32_t fields);
+
+/*!
+  Selects the message types to decode: bit n of types stands for type n.
+  Sentences of other types are rejected from the first payload character,
+  without decoding anything else. Once fragment 1 of a multipart message
+  has been rejected, its other fragments are too, without being buffered;
+  each sentence counts as AIS_REJECT_FILTERED. All types are decoded by
+  default.
+*/
+void ais_select_types(ais_handle_t *handle, uint64_t types);
+
+/*!
+  Gives handle the settings of from: its source, reassembly limits,
+  checksum verification and field and type selection. Reassembly state,
+  statistics and the vessel table are not copied.
+*/
+void ais_copy_settings(ais_handle_t *handle, const ais_handle_t *from);
+
+/*!
+  Keeps the last known state of vessels in table (see ais_vessel.h): every
+  message decoded through handle from now on, by any of the decode
+  functions, is merged into it. NULL stops this. The table is not owned
+  by the handle, and may be shared by handles used on the same thread.
+  Fields not selected by ais_select_fields() are not merged: the records
+  keep their last known values.
+*/
+void ais_set_vessel_table(ais_handle_t *handle, struct ais_vessel_table_t *table);
+
+/*!
+  Sends log messages to callback, already formatted, instead of printing
+  them to stdout; NULL restores printing. This is process-wide, and the
+  callback runs on whichever thread is decoding. Which messages are
+  logged depends on the debug level passed to the decode functions, and
+  on the GPSD_MAX_LOG_LEVEL they were compiled with (see gpsd.h).
+*/
+typedef void (*ais_log_callback_t)(int level, const char *message, void *userdata);
+
+void ais_set_log_callback(ais_log_callback_t callback, void *userdata);
+
+typedef void (*ais_callback_t)(const struct ais_t *ais, void *userdata);
+
+/*!
+  Decodes newline-delimited sentences in buf[0..buflen), in order, calling
+  callback for each completed message. Trailing CR characters and empty
+  lines are ignored. Returns the number of completed messages.
+*/
+size_t ais_decode_lines(ais_handle_t *handle,
+                        const char *buf, size_t buflen,
+                        ais_callback_t callback, void *userdata,
+                        bool split24,
+                        int debug);
+
+/*!
+  Decodes an arbitrary chunk of a raw NMEA byte stream, calling callback
+  for each completed message. Sentences start at '!', or at the backslash
+  of a tag block before it, and end at CR or LF; a sentence which is
+  incomplete at the end of the chunk is kept in the handle and completed
+  by the next call. Only !AIVDM and !AIVDO sentences are decoded; anything
+  else in the stream is skipped. Returns the number of completed messages.
+*/
+size_t ais_decode_stream(ais_handle_t *handle,
+                         const char *buf, size_t buflen,
+                         ais_callback_t callback, void *userdata,
+                         bool split24,
+                         int debug);
+
+/*!
+  Decodes the newline-delimited sentences of the file at path, like
+  ais_decode_lines() but on up to threads threads (0 for one per online
+  CPU). The file is memory-mapped and split into line-aligned chunks of
+  about AIS_FILE_CHUNK bytes, each decoded through its own handle with the
+  settings of handle. Before its first line, each chunk is primed with the
+  AIS_FILE_OVERLAP lines preceding it, so multipart messages straddling
+  chunk boundaries are reassembled as by a single handle, unless their
+  fragments are further apart than that, or fragment 1 comes after the
+  boundary and a later one before it. Only fragment 1 starts a message in
+  the primer, so fragments left over from before it aren't joined to the
+  wrong message. callback is called on the calling thread for each
+  message, in file order, after merging it into the vessel table of
+  handle, if any; from the callback, ais_get_tagblock() on handle returns
+  the tag block of the message. The statistics of the file are added to
+  those of handle; its own reassembly state is left alone. Returns the
+  number of completed messages, or -1 with errno set if the file can't be
+  read.
+*/
+#define AIS_FILE_CHUNK (256 * 1024)
+#define AIS_FILE_OVERLAP 64
+
+long ais_decode_file(ais_handle_t *handle, const char *path,
+                     unsigned int threads,
+                     ais_callback_t callback, void *userdata,
+                     bool split24,
+                     int debug);
+
+/*!
+  Encodes ais into AIVDM sentences for channel ('A' or 'B'), the inverse of
+  ais_decode(): the fixed-format types of ais_layout.h and type 24, one part
+  at a time as given by ais->type24.part. Messages of more than one
+  sentence carry seqid % 10 as their sequential message ID. Writes the
+  CRLF-terminated sentences and a NUL to buf, for which AIS_ENCODE_MAX_LEN
+  bytes are enough. Returns their length, or 0 if the type can't be
+  encoded or buf is too small.
+*/
+#define AIS_ENCODE_MAX_LEN 192
+
+size_t ais_encode(const struct ais_t *ais, char channel, unsigned int seqid,
+                  char *buf, size_t buflen);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -1,13 +1,16 @@
 #include "aivdm_decode.h"
 #include "gpsd.h" // for gpsd_report()
-#include "driver_ais.h" // for ais_binary_decode()
+#include "driver_ais.h" // for ais_binary_decode(), ais_position_decode()
+#include "aivdm_simd.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdarg.h>
 #include <ctype.h>
+#include <time.h>
 
 /**************************************************************************
  *
@@ -15,70 +18,651 @@
  *
  **************************************************************************/
 
+/*
+ * 6-bit value of each armoring character: subtract 48, and another 8 if
+ * the result is 40 or more. Characters outside the armoring alphabet
+ * map to the low 6 bits of the same computation.
+ */
+static const unsigned char sixbit_values[256] = {
+     8,  9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23,
+    24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39,
+    40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15,
+    16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31,
+    32, 33, 34, 35, 36, 37, 38, 39, 32, 33, 34, 35, 36, 37, 38, 39,
+    40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55,
+    56, 57, 58, 59, 60, 61, 62, 63,  0,  1,  2,  3,  4,  5,  6,  7,
+     8,  9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23,
+    24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39,
+    40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55,
+    56, 57, 58, 59, 60, 61, 62, 63,  0,  1,  2,  3,  4,  5,  6,  7,
+     8,  9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23,
+    24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39,
+    40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55,
+    56, 57, 58, 59, 60, 61, 62, 63,  0,  1,  2,  3,  4,  5,  6,  7,
+};
+
+/* armoring character of each 6-bit value, the inverse of the above */
+static const char armor_chars[64] =
+    "0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVW`abcdefghijklmnopqrstuvw";
+
+static void put_sixbit(unsigned char *bits, size_t bitlen, unsigned char v)
+/* OR a 6-bit value into bits at an arbitrary bit offset */
+{
+    size_t i = bitlen / 8;
+    unsigned int shift = bitlen % 8;
+    unsigned int w = (unsigned int)v << (10 - shift);
+
+    bits[i] |= (unsigned char)(w >> 8);
+    if (shift > 2)
+	bits[i + 1] |= (unsigned char)w;
+}
+
+/*
+ * Vectorized kernel for unpacking aligned runs of characters. It is
+ * selected on first use; concurrent first uses race benignly, as they
+ * all select the same kernel.
+ */
+static aivdm_unpack_fn unpack_kernel;
+static const char *unpack_kernel_name;
+
+const char *aivdm_dearmor_select(bool simd)
+/* choose the SIMD kernel (if simd and supported) or the scalar path */
+{
+    const char *name;
+    aivdm_unpack_fn kernel = simd ? aivdm_unpack_select(&name) : NULL;
+
+    if (kernel == NULL)
+	name = "scalar";
+    unpack_kernel = kernel;
+    unpack_kernel_name = name;
+    return name;
+}
+
+void aivdm_dearmor(unsigned char *bits, size_t *bitlen,
+		   const unsigned char *data, size_t len)
+/* append the armored payload data[0..len) to bits, starting at *bitlen */
+{
+    const unsigned char *end = data + len;
+    size_t n = *bitlen;
+
+    /*
+     * Go one character at a time until we are byte aligned. Offsets
+     * are normally even, so this takes at most 3 characters.
+     */
+    while (data < end && (n % 8) != 0) {
+	put_sixbit(bits, n, sixbit_values[*data++]);
+	n += 6;
+    }
+    if ((n % 8) == 0) {
+	unsigned char *out = bits + n / 8;
+
+	if (unpack_kernel_name == NULL)
+	    (void)aivdm_dearmor_select(true);
+	if (unpack_kernel != NULL) {
+	    size_t done = unpack_kernel(out, data, (size_t)(end - data));
+	    data += done;
+	    out += done / 4 * 3;
+	    n += 6 * done;
+	}
+	/* 4 characters make 3 whole bytes */
+	while (end - data >= 4) {
+	    uint32_t w = ((uint32_t)sixbit_values[data[0]] << 18)
+		| ((uint32_t)sixbit_values[data[1]] << 12)
+		| ((uint32_t)sixbit_values[data[2]] << 6)
+		| (uint32_t)sixbit_values[data[3]];
+	    out[0] = (unsigned char)(w >> 16);
+	    out[1] = (unsigned char)(w >> 8);
+	    out[2] = (unsigned char)w;
+	    out += 3;
+	    data += 4;
+	    n += 24;
+	}
+    }
+    while (data < end) {
+	put_sixbit(bits, n, sixbit_values[*data++]);
+	n += 6;
+    }
+    *bitlen = n;
+}
+
+static int field_atoi(const unsigned char *field, size_t len)
+/* atoi() for a field which isn't NUL-terminated */
+{
+    int n = 0;
+
+    for (; len > 0 && isspace(*field); len--)
+	field++;
+    while (len-- > 0 && isdigit(*field))
+	n = n * 10 + (*field++ - '0');
+    return n;
+}
+
+static int aivdm_hexval(unsigned char c)
+/* value of a hex digit, or -1 */
+{
+    if (c >= '0' && c <= '9')
+	return c - '0';
+    if (c >= 'A' && c <= 'F')
+	return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f')
+	return c - 'a' + 10;
+    return -1;
+}
+
+static unsigned int aivdm_checksum(const unsigned char *cp,
+				   const unsigned char *end)
+/* XOR of the bytes from cp up to end */
+{
+    uint64_t w0 = 0, w1 = 0, w;
+    unsigned int sum;
+
+    /*
+     * XOR works bytewise, so whole words can be combined first and
+     * folded into a byte at the end, whatever the byte order.
+     */
+    for (; end - cp >= 16; cp += 16) {
+	(void)memcpy(&w, cp, sizeof(w));
+	w0 ^= w;
+	(void)memcpy(&w, cp + 8, sizeof(w));
+	w1 ^= w;
+    }
+    if (end - cp >= 8) {
+	(void)memcpy(&w, cp, sizeof(w));
+	w0 ^= w;
+	cp += 8;
+    }
+    w = w0 ^ w1;
+    w ^= w >> 32;
+    w ^= w >> 16;
+    w ^= w >> 8;
+    sum = (unsigned int)(w & 0xff);
+    while (cp < end)
+	sum ^= *cp++;
+    return sum;
+}
+
+static bool aivdm_checksum_ok(const char *buf, size_t buflen)
+/* does the sentence end with a correct *hh checksum? */
+{
+    const unsigned char *star;
+    unsigned int sum;
+    int hi, lo;
+
+    while (buflen > 0 && isspace((unsigned char)buf[buflen - 1]))
+	buflen--;
+    if (buflen < 4 || buf[buflen - 3] != '*')
+	return false;
+    star = (const unsigned char *)buf + buflen - 3;
+
+    /* the checksum XORs the bytes between the leading '!' and the '*' */
+    sum = aivdm_checksum((const unsigned char *)buf + 1, star);
+
+    hi = aivdm_hexval(star[1]);
+    lo = aivdm_hexval(star[2]);
+    return hi >= 0 && lo >= 0 && sum == (unsigned int)(hi << 4 | lo);
+}
+
+static void aivdm_tag_group(struct gps_device_t *session)
+/* carry the time and source of a group's first sentence over to the rest */
+{
+    struct ais_tagblock_t *tag = &session->driver.aivdm.tagblock;
+    struct aivdm_tag_group_t *group = &session->driver.aivdm.tag_group;
+
+    if ((tag->fields & AIS_TAG_GROUP) == 0)
+	return;
+    if (tag->group_sentence == 1) {
+	group->id = tag->group_id;
+	group->fields = tag->fields & (AIS_TAG_TIME | AIS_TAG_SOURCE);
+	group->time = tag->time;
+	group->source_len = 0;
+	if (tag->fields & AIS_TAG_SOURCE) {
+	    group->source_len = tag->source_len < AIS_TAG_SOURCE_MAX
+		? tag->source_len : AIS_TAG_SOURCE_MAX;
+	    (void)memcpy(group->source, tag->source, group->source_len);
+	}
+    } else if (tag->group_id == group->id) {
+	if ((tag->fields & AIS_TAG_TIME) == 0 && (group->fields & AIS_TAG_TIME)) {
+	    tag->time = group->time;
+	    tag->fields |= AIS_TAG_TIME;
+	}
+	if ((tag->fields & AIS_TAG_SOURCE) == 0
+	    && (group->fields & AIS_TAG_SOURCE)) {
+	    tag->source = group->source;
+	    tag->source_len = group->source_len;
+	    tag->fields |= AIS_TAG_SOURCE;
+	}
+    }
+}
+
+static size_t aivdm_tagblock(const char *buf, size_t buflen,
+			     struct gps_device_t *session)
+/* parse the tag block buf starts with; its length, or 0 if invalid */
+{
+    struct ais_tagblock_t *tag = &session->driver.aivdm.tagblock;
+    const unsigned char *cp = (const unsigned char *)buf + 1;
+    const unsigned char *close, *star;
+    int hi, lo;
+
+    /* \code:value,...*hh\, with the checksum over what is between */
+    close = memchr(cp, '\\', buflen - 1);
+    if (close == NULL || close - cp < 3 || close[-3] != '*')
+	return 0;
+    star = close - 3;
+    hi = aivdm_hexval(star[1]);
+    lo = aivdm_hexval(star[2]);
+    if (hi < 0 || lo < 0 || aivdm_checksum(cp, star) != (unsigned int)(hi << 4 | lo))
+	return 0;
+
+    /* fields other than the time, source and group are skipped */
+    while (cp < star) {
+	const unsigned char *comma = memchr(cp, ',', (size_t)(star - cp));
+	const unsigned char *next = comma != NULL ? comma : star;
+	const unsigned char *value = cp + 2, *dash1, *dash2;
+
+	if (next - cp >= 2 && cp[1] == ':') {
+	    switch (cp[0]) {
+	    case 'c':
+		tag->time = 0;
+		for (; value < next && isdigit(*value); value++)
+		    tag->time = tag->time * 10 + (*value - '0');
+		tag->fields |= AIS_TAG_TIME;
+		break;
+	    case 's':
+		tag->source = (const char *)value;
+		tag->source_len = (size_t)(next - value);
+		tag->fields |= AIS_TAG_SOURCE;
+		break;
+	    case 'g':
+		/* sentence-count-id */
+		dash1 = memchr(value, '-', (size_t)(next - value));
+		dash2 = dash1 != NULL
+		    ? memchr(dash1 + 1, '-', (size_t)(next - dash1 - 1)) : NULL;
+		if (dash2 == NULL)
+		    break;
+		tag->group_sentence =
+		    (unsigned int)field_atoi(value, (size_t)(dash1 - value));
+		tag->group_count = (unsigned int)field_atoi(dash1 + 1,
+		    (size_t)(dash2 - dash1 - 1));
+		tag->group_id = (unsigned int)field_atoi(dash2 + 1,
+		    (size_t)(next - dash2 - 1));
+		tag->fields |= AIS_TAG_GROUP;
+		break;
+	    }
+	}
+	cp = comma != NULL ? comma + 1 : star;
+    }
+    aivdm_tag_group(session);
+    return (size_t)(close - (const unsigned char *)buf) + 1;
+}
+
+size_t aivdm_armor(const unsigned char *bits, size_t bitlen,
+		   char channel, unsigned int seqid, char *buf, size_t buflen)
+/* armor a message into AIVDM sentences in buf; 0 if they don't fit */
+{
+    char payload[AIVDM_MAX_FRAGS * AIVDM_ARMOR_CHARS];
+    size_t nchars = (bitlen + 5) / 6, bytes = (bitlen + 7) / 8;
+    size_t i, len, out = 0;
+    unsigned int pad = (unsigned int)(nchars * 6 - bitlen);
+    int nfrags, ifrag;
+
+    if (nchars > sizeof(payload))
+	return 0;
+    /* 3 bytes make 4 characters; the pad bits are cleared */
+    for (i = 0; i < nchars; i += 4) {
+	size_t b = i / 4 * 3;
+	uint32_t w = ((uint32_t)bits[b] << 16)
+	    | (b + 1 < bytes ? (uint32_t)bits[b + 1] << 8 : 0)
+	    | (b + 2 < bytes ? (uint32_t)bits[b + 2] : 0);
+	payload[i] = (char)(w >> 18);
+	payload[i + 1] = (char)((w >> 12) & 0x3f);
+	payload[i + 2] = (char)((w >> 6) & 0x3f);
+	payload[i + 3] = (char)(w & 0x3f);
+    }
+    if (nchars > 0)
+	payload[nchars - 1] = (char)(payload[nchars - 1] & (0x3f << pad));
+    for (i = 0; i < nchars; i++)
+	payload[i] = armor_chars[(unsigned char)payload[i]];
+
+    nfrags = nchars == 0 ? 1 : (int)((nchars + AIVDM_ARMOR_CHARS - 1)
+				     / AIVDM_ARMOR_CHARS);
+    for (ifrag = 1; ifrag <= nfrags; ifrag++) {
+	size_t start = (size_t)(ifrag - 1) * AIVDM_ARMOR_CHARS;
+	char *cp = buf + out;
+	unsigned int sum;
+
+	len = nchars - start < AIVDM_ARMOR_CHARS ? nchars - start
+	    : AIVDM_ARMOR_CHARS;
+	/* !AIVDM,n,i,s,c,payload,p*hh\r\n and a NUL */
+	if (buflen - out < len + 23)
+	    return 0;
+	(void)memcpy(cp, "!AIVDM,", 7);
+	cp += 7;
+	*cp++ = (char)('0' + nfrags);
+	*cp++ = ',';
+	*cp++ = (char)('0' + ifrag);
+	*cp++ = ',';
+	if (nfrags > 1)
+	    *cp++ = (char)('0' + seqid % 10);
+	*cp++ = ',';
+	*cp++ = channel;
+	*cp++ = ',';
+	(void)memcpy(cp, payload + start, len);
+	cp += len;
+	*cp++ = ',';
+	*cp++ = (char)('0' + (ifrag == nfrags ? pad : 0));
+	sum = aivdm_checksum((const unsigned char *)buf + out + 1,
+			     (const unsigned char *)cp);
+	*cp++ = '*';
+	*cp++ = "0123456789ABCDEF"[sum >> 4];
+	*cp++ = "0123456789ABCDEF"[sum & 0x0f];
+	*cp++ = '\r';
+	*cp++ = '\n';
+	out = (size_t)(cp - buf);
+    }
+    buf[out] = '\0';
+    return out;
+}
+
+static void aivdm_reject(struct gps_device_t *session,
+			 enum ais_reject_t reason)
+/* count a sentence rejected before it made up a message */
+{
+    session->driver.aivdm.stats.rejected[reason]++;
+}
+
+static unsigned long aivdm_msec(void)
+/* monotonic clock for expiring incomplete messages, in milliseconds */
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static unsigned int aivdm_clock_hash(unsigned int source)
+{
+    return ((source * 2654435761u) >> 16) % AIVDM_SOURCE_CLOCKS;
+}
+
+static struct aivdm_clock_t *aivdm_clock(struct gps_device_t *session,
+					 unsigned int source)
+/* the clock of a source, or the free one to start it in */
+{
+    struct aivdm_clock_t *clocks = session->driver.aivdm.clocks;
+    unsigned int i = aivdm_clock_hash(source);
+
+    while (clocks[i].slots != 0 && clocks[i].source != source)
+	i = (i + 1) % AIVDM_SOURCE_CLOCKS;
+    return &clocks[i];
+}
+
+static void aivdm_claim(struct gps_device_t *session,
+			struct aivdm_slot_t *slot, unsigned int source)
+/* take a free slot for a message from source, starting its clock if need be */
+{
+    struct aivdm_clock_t *clock = aivdm_clock(session, source);
+
+    if (clock->slots++ == 0) {
+	clock->source = source;
+	clock->sentences = 0;
+    }
+    slot->used = true;
+    slot->source = source;
+}
+
+static void aivdm_release(struct gps_device_t *session,
+			  struct aivdm_slot_t *slot)
+/* free a slot, and the clock of its source with the last one */
+{
+    struct aivdm_clock_t *clocks = session->driver.aivdm.clocks;
+    struct aivdm_clock_t *clock = aivdm_clock(session, slot->source);
+    unsigned int hole, i;
+
+    slot->used = false;
+    if (--clock->slots != 0)
+	return;
+    /* shift back the clocks probed past it, so lookups still find them */
+    hole = (unsigned int)(clock - clocks);
+    for (i = (hole + 1) % AIVDM_SOURCE_CLOCKS; clocks[i].slots != 0;
+	 i = (i + 1) % AIVDM_SOURCE_CLOCKS) {
+	unsigned int home = aivdm_clock_hash(clocks[i].source);
+
+	if ((i - home) % AIVDM_SOURCE_CLOCKS
+	    >= (i - hole) % AIVDM_SOURCE_CLOCKS) {
+	    clocks[hole] = clocks[i];
+	    clocks[i].slots = 0;
+	    hole = i;
+	}
+    }
+}
+
+static void aivdm_drop(struct gps_device_t *session, struct aivdm_slot_t *slot)
+/* discard the fragments buffered in a slot */
+{
+    unsigned int received;
+
+    /* those of a filtered message were counted as such */
+    if (!slot->filtered)
+	for (received = slot->received; received != 0; received &= received - 1)
+	    session->driver.aivdm.stats.reassembly.dropped++;
+    slot->filtered = false;
+    slot->nfrags = 0;
+    slot->received = 0;
+    slot->payload_used = 0;
+    slot->stamp = session->driver.aivdm.sentences;
+    slot->sentence = aivdm_clock(session, slot->source)->sentences;
+    slot->msec = session->driver.aivdm.msec;
+}
+
+static bool aivdm_expired(struct gps_device_t *session,
+			  const struct aivdm_slot_t *slot)
+/* has an incomplete message waited too long for its other fragments? */
+{
+    unsigned long max_sentences = session->driver.aivdm.max_sentences;
+    unsigned long timeout_msec = session->driver.aivdm.timeout_msec;
+    unsigned long sentence = aivdm_clock(session, slot->source)->sentences;
+
+    return (max_sentences != 0 && sentence - slot->sentence > max_sentences)
+	|| (timeout_msec != 0
+	    && session->driver.aivdm.msec - slot->msec > timeout_msec);
+}
+
+void aivdm_flush(struct gps_device_t *session, unsigned long stamp)
+/* expire the incomplete messages whose first fragment came before stamp */
+{
+    int i;
+
+    for (i = 0; i < AIVDM_SLOTS; i++) {
+	struct aivdm_slot_t *slot = &session->driver.aivdm.slots[i];
+
+	if (slot->used && slot->stamp < stamp) {
+	    session->driver.aivdm.stats.reassembly.expired++;
+	    aivdm_drop(session, slot);
+	    aivdm_release(session, slot);
+	}
+    }
+}
+
+static struct aivdm_slot_t *aivdm_slot(struct gps_device_t *session,
+				       char seqid, bool claim)
+/* find the slot of a multipart message, or claim one if asked to */
+{
+    struct aivdm_slot_t *slot, *victim = NULL;
+    unsigned int source = session->driver.aivdm.source;
+    char channel = session->driver.aivdm.ais_channel;
+    unsigned int hash, i;
+
+    /* mix again so channel and source reach the top bits kept */
+    hash = ((source * 2654435761u) ^ ((unsigned int)channel << 8)
+	    ^ (unsigned char)seqid) * 2654435761u;
+    hash >>= 32 - AIVDM_SLOT_BITS;
+    for (i = 0; i < AIVDM_PROBE; i++) {
+	slot = &session->driver.aivdm.slots[(hash + i) % AIVDM_SLOTS];
+	if (slot->used && aivdm_expired(session, slot)) {
+	    gpsd_report(session->context->debug, LOG_INF,
+			"incomplete AIVDM message expired.\n");
+	    session->driver.aivdm.stats.reassembly.expired++;
+	    aivdm_drop(session, slot);
+	    aivdm_release(session, slot);
+	}
+	if (slot->used && slot->source == source
+	    && slot->channel == channel && slot->seqid == seqid)
+	    return slot;
+	/* prefer a free slot, else the one holding the oldest message */
+	if (victim == NULL
+	    || (victim->used && (!slot->used || slot->stamp < victim->stamp)))
+	    victim = slot;
+    }
+
+    if (!claim)
+	return NULL;
+    if (victim->used) {
+	gpsd_report(session->context->debug, LOG_WARN,
+		    "dropping incomplete AIVDM message to make room.\n");
+	session->driver.aivdm.stats.reassembly.evicted++;
+	aivdm_release(session, victim);
+    }
+    aivdm_claim(session, victim, source);
+    victim->channel = channel;
+    victim->seqid = seqid;
+    aivdm_drop(session, victim);
+    return victim;
+}
+
+static bool aivdm_filtered(const struct gps_device_t *session,
+			   const unsigned char *data, size_t datalen)
+/* is the type of a message, in the first character of fragment 1, unwanted? */
+{
+    return datalen > 0
+	&& ((session->driver.aivdm.skip_types >> sixbit_values[data[0]]) & 1);
+}
+
+static struct aivdm_context_t *aivdm_build(struct gps_device_t *session,
+					   const unsigned char *const data[],
+					   const size_t datalen[],
+					   const unsigned char pad[],
+					   int nfrags)
+/* de-armor the fragments of a complete message, in order */
+{
+    struct aivdm_context_t *ais_context = &session->driver.aivdm.assembly;
+    int i;
+
+    /* only the bytes written since the last clear can be nonzero */
+    (void)memset(ais_context->bits, '\0', ais_context->bytes_used);
+    ais_context->bytes_used = 0;
+    ais_context->bitlen = 0;
+    for (i = 0; i < nfrags; i++) {
+	/* wacky 6-bit encoding, shades of FIELDATA */
+	if (ais_context->bitlen + 6 * datalen[i] > sizeof(ais_context->bits)) {
+	    gpsd_report(session->context->debug, LOG_INF,
+			"overlong AIVDM payload truncated.\n");
+	    aivdm_reject(session, AIS_REJECT_PAYLOAD);
+	    return NULL;
+	}
+	aivdm_dearmor(ais_context->bits, &ais_context->bitlen,
+		      data[i], datalen[i]);
+	if ((ais_context->bitlen + 7) / 8 > ais_context->bytes_used)
+	    ais_context->bytes_used = (ais_context->bitlen + 7) / 8;
+	/*@ +charint @*/
+	if (isdigit(pad[i]))
+	    ais_context->bitlen -= (pad[i] - '0');	/* ASCII assumption */
+	/*@ -charint @*/
+    }
+    return ais_context;
+}
+
 /*@ -fixedformalarray -usedef -branchstate @*/
-bool aivdm_decode(const char *buf, size_t buflen,
-		  struct gps_device_t *session,
-		  struct ais_t *ais,
-		  bool split24, int debug)
+static struct aivdm_context_t *aivdm_assemble(const char *buf, size_t buflen,
+					      struct gps_device_t *session)
+/* add a sentence to its channel; return the channel once a message is whole */
 {
-#ifdef __UNUSED_DEBUG__
-    char *sixbits[64] = {
-	"000000", "000001", "000010", "000011", "000100",
-	"000101", "000110", "000111", "001000", "001001",
-	"001010", "001011", "001100", "001101", "001110",
-	"001111", "010000", "010001", "010010", "010011",
-	"010100", "010101", "010110", "010111", "011000",
-	"011001", "011010", "011011", "011100", "011101",
-	"011110", "011111", "100000", "100001", "100010",
-	"100011", "100100", "100101", "100110", "100111",
-	"101000", "101001", "101010", "101011", "101100",
-	"101101", "101110", "101111", "110000", "110001",
-	"110010", "110011", "110100", "110101", "110110",
-	"110111", "111000", "111001", "111010", "111011",
-	"111100", "111101", "111110", "111111",
-    };
-#endif /* __UNUSED_DEBUG__ */
-    int nfrags, ifrag, nfields = 0;
-    unsigned char *field[NMEA_MAX*2];
-    unsigned char fieldcopy[NMEA_MAX*2+1];
-    unsigned char *data, *cp;
-    unsigned char ch, pad;
-    struct aivdm_context_t *ais_context;
+    int nfrags, ifrag, nfields;
+    const unsigned char *field[7];
+    size_t fieldlen[7];
+    const unsigned char *data, *cp, *end;
+    unsigned char pad;
+    size_t datalen;
+    const unsigned char *frags[AIVDM_MAX_FRAGS];
+    size_t fraglen[AIVDM_MAX_FRAGS];
+    struct aivdm_slot_t *slot;
+    struct aivdm_clock_t *clock;
     int i;
 
     if (buflen == 0)
-	return false;
+	return NULL;
+    session->driver.aivdm.stats.sentences++;
+
+    /* the clocks incomplete messages expire by */
+    session->driver.aivdm.sentences++;
+    clock = aivdm_clock(session, session->driver.aivdm.source);
+    if (clock->slots != 0)
+	clock->sentences++;
+    if (session->driver.aivdm.timeout_msec != 0)
+	session->driver.aivdm.msec = aivdm_msec();
 
     /* we may need to dump the raw packet */
     gpsd_report(session->context->debug, LOG_PROG,
-		"AIVDM packet length %zd: %s\n", buflen, buf);
+		"AIVDM packet length %zd: %.*s\n", buflen, (int)buflen, buf);
+
+    /* an NMEA 4.0 tag block may come first; the sentence follows it */
+    if (session->driver.aivdm.tagblock.fields != 0)
+	(void)memset(&session->driver.aivdm.tagblock, 0,
+		     sizeof(session->driver.aivdm.tagblock));
+    if (buf[0] == '\\') {
+	size_t taglen = aivdm_tagblock(buf, buflen, session);
 
-    /* first clear the result, making sure we don't return garbage */
-    memset(ais, 0, sizeof(*ais));
+	if (taglen == 0) {
+	    gpsd_report(session->context->debug, LOG_WARN,
+			"invalid tag block in AIVDM packet.\n");
+	    aivdm_reject(session, AIS_REJECT_TAGBLOCK);
+	    return NULL;
+	}
+	buf += taglen;
+	buflen -= taglen;
+    }
 
     /* discard overlong sentences */
-    if (strlen(buf) > sizeof(fieldcopy)-1) {
+    if (buflen > NMEA_MAX*2) {
 	gpsd_report(session->context->debug, LOG_ERROR, "overlong AIVDM packet.\n");
-	return false;
+	aivdm_reject(session, AIS_REJECT_OVERLONG);
+	return NULL;
     }
 
-    /* extract packet fields */
-    (void)strlcpy((char *)fieldcopy, buf, sizeof(fieldcopy));
-    field[nfields++] = (unsigned char *)buf;
-    for (cp = fieldcopy;
-	 cp < fieldcopy + buflen; cp++)
-	if (*cp == (unsigned char)',') {
-	    *cp = '\0';
-	    field[nfields++] = cp + 1;
+    /* reject corrupted sentences before looking at their fields */
+    if (session->driver.aivdm.verify_checksum && !aivdm_checksum_ok(buf, buflen)) {
+	gpsd_report(session->context->debug, LOG_WARN,
+		    "bad checksum in AIVDM packet.\n");
+	aivdm_reject(session, AIS_REJECT_CHECKSUM);
+	return NULL;
+    }
+
+    /*
+     * Locate the packet fields in place; buf need not be NUL-terminated.
+     * Only the first seven are used, and the last of those may run on.
+     */
+    cp = (const unsigned char *)buf;
+    end = cp + buflen;
+    for (nfields = 0; nfields < 7; nfields++) {
+	const unsigned char *comma = memchr(cp, ',', (size_t)(end - cp));
+
+	field[nfields] = cp;
+	if (comma == NULL) {
+	    fieldlen[nfields++] = (size_t)(end - cp);
+	    break;
 	}
+	fieldlen[nfields] = (size_t)(comma - cp);
+	cp = comma + 1;
+    }
 
     /* discard sentences with exiguous commas; catches run-ons */
     if (nfields < 7) {
 	gpsd_report(session->context->debug, LOG_ERROR, "malformed AIVDM packet.\n");
-	return false;
+	aivdm_reject(session, AIS_REJECT_MALFORMED);
+	return NULL;
     }
 
-    switch (field[4][0]) {
+    switch (fieldlen[4] > 0 ? field[4][0] : '\0') {
     /* FIXME: if fields[4] == "12", it doesn't detect the error */
     case '\0':
 	/*
@@ -86,116 +670,256 @@ bool aivdm_decode(const char *buf, size_t buflen,
 	 * which makes sense as they don't come in over radio.  This
 	 * is going to break if there's ever an AIVDO type 24, though.
 	 */
-	if (strncmp((const char *)field[0], "!AIVDO", 6) != 0)
+	if (fieldlen[0] < 6 || memcmp(field[0], "!AIVDO", 6) != 0)
 	    gpsd_report(session->context->debug, LOG_INF,
-			"invalid empty AIS channel. Assuming 'A': [%s]", field[0]);
-	ais_context = &session->driver.aivdm.context[0];
+			"invalid empty AIS channel. Assuming 'A': [%.*s]",
+			(int)fieldlen[0], field[0]);
 	session->driver.aivdm.ais_channel ='A';
 	break;
     case '1':
 	/*@fallthrough@*/
     case 'A':
-	ais_context = &session->driver.aivdm.context[0];
 	session->driver.aivdm.ais_channel ='A';
 	break;
     case '2':
 	/*@fallthrough@*/
     case 'B':
-	ais_context = &session->driver.aivdm.context[1];
 	session->driver.aivdm.ais_channel ='B';
 	break;
     case 'C':
 	gpsd_report(session->context->debug, LOG_INF,
 		    "ignoring AIS channel C (secure AIS).\n");
-        return false;
+	aivdm_reject(session, AIS_REJECT_CHANNEL);
+        return NULL;
         break;
     default:
 	gpsd_report(session->context->debug, LOG_ERROR,
 		    "invalid AIS channel 0x%0X .\n", field[4][0]);
-	return false;
+	aivdm_reject(session, AIS_REJECT_CHANNEL);
+	return NULL;
     }
 
-    nfrags = atoi((char *)field[1]); /* number of fragments to expect */
-    ifrag = atoi((char *)field[2]); /* fragment id */
+    nfrags = field_atoi(field[1], fieldlen[1]); /* number of fragments to expect */
+    ifrag = field_atoi(field[2], fieldlen[2]); /* fragment id */
     data = field[5];
-    pad = field[6][0]; /* number of padding bits */
+    datalen = fieldlen[5];
+    pad = fieldlen[6] > 0 ? field[6][0] : '\0'; /* number of padding bits */
     gpsd_report(session->context->debug, LOG_PROG,
-		"nfrags=%d, ifrag=%d, decoded_frags=%d, data=%s\n",
-		nfrags, ifrag, ais_context->decoded_frags, data);
+		"nfrags=%d, ifrag=%d, data=%.*s\n",
+		nfrags, ifrag, (int)datalen, data);
 
-    /* assemble the binary data */
+    /* single-sentence messages need no slot, and leave pending ones alone */
+    if (nfrags <= 1) {
+	if (ifrag != 1) {
+	    gpsd_report(session->context->debug, LOG_ERROR,
+			"invalid fragment #%d received, expected #1.\n",
+			ifrag);
+	    aivdm_reject(session, AIS_REJECT_FRAGMENT);
+	    return NULL;
+	}
+	if (aivdm_filtered(session, data, datalen)) {
+	    aivdm_reject(session, AIS_REJECT_FILTERED);
+	    return NULL;
+	}
+	return aivdm_build(session, &data, &datalen, &pad, 1);
+    }
 
-    /* check fragment ordering */
-    if (ifrag != ais_context->decoded_frags + 1) {
+    if (nfrags > AIVDM_MAX_FRAGS || ifrag < 1 || ifrag > nfrags) {
 	gpsd_report(session->context->debug, LOG_ERROR,
-		    "invalid fragment #%d received, expected #%d.\n",
-		    ifrag, ais_context->decoded_frags + 1);
-	if (ifrag != 1)
-	    return false;
-        /* else, ifrag==1: Just discard all that was previously decoded and
-         * simply handle that packet */
-        ais_context->decoded_frags = 0;
-    }
-    if (ifrag == 1) {
-	(void)memset(ais_context->bits, '\0', sizeof(ais_context->bits));
-	ais_context->bitlen = 0;
-    }
-
-    /* wacky 6-bit encoding, shades of FIELDATA */
-    /*@ +charint @*/
-    for (cp = data; cp < data + strlen((char *)data); cp++) {
-	ch = *cp;
-	ch -= 48;
-	if (ch >= 40)
-	    ch -= 8;
-#ifdef __UNUSED_DEBUG__
-	gpsd_report(session->context->debug, LOG_RAW,
-		    "%c: %s\n", *cp, sixbits[ch]);
-#endif /* __UNUSED_DEBUG__ */
-	/*@ -shiftnegative @*/
-	for (i = 5; i >= 0; i--) {
-	    if ((ch >> i) & 0x01) {
-		ais_context->bits[ais_context->bitlen / 8] |=
-		    (1 << (7 - ais_context->bitlen % 8));
-	    }
-	    ais_context->bitlen++;
-	    if (ais_context->bitlen > sizeof(ais_context->bits)) {
-		gpsd_report(session->context->debug, LOG_INF,
-			    "overlong AIVDM payload truncated.\n");
-		return false;
-	    }
-	}
-	/*@ +shiftnegative @*/
+		    "invalid fragment #%d of %d received.\n", ifrag, nfrags);
+	aivdm_reject(session, AIS_REJECT_FRAGMENT);
+	session->driver.aivdm.stats.reassembly.dropped++;
+	return NULL;
+    }
+    /*
+     * When starting mid-stream, a later fragment may belong to a message
+     * begun before; only fragment 1 can start one then.
+     */
+    slot = aivdm_slot(session, fieldlen[3] > 0 ? (char)field[3][0] : '\0',
+		      ifrag == 1 || !session->driver.aivdm.in_order);
+    if (slot == NULL) {
+	session->driver.aivdm.stats.reassembly.dropped++;
+	return NULL;
+    }
+    if (slot->nfrags != 0
+	&& (slot->nfrags != nfrags || (slot->received & (1u << (ifrag - 1))))) {
+	/* the sequential message ID has been reused before completion */
+	gpsd_report(session->context->debug, LOG_ERROR,
+		    "fragment #%d received again, dropping incomplete message.\n",
+		    ifrag);
+	aivdm_drop(session, slot);
     }
-    if (isdigit(pad))
-	ais_context->bitlen -= (pad - '0');	/* ASCII assumption */
-    /*@ -charint @*/
 
-    /* time to pass buffered-up data to where it's actually processed? */
-    if (ifrag == nfrags) {
-#if 0
-	if (debug >= LOG_INF) {
-	    size_t clen = (ais_context->bitlen + 7) / 8;
-	    gpsd_report(session->context->debug, LOG_INF,
-			"AIVDM payload is %zd bits, %zd chars: %s\n",
-			ais_context->bitlen, clen,
-			gpsd_hexdump(session->msgbuf, sizeof(session->msgbuf),
-				     (char *)ais_context->bits, clen));
+    /*
+     * The message type is in the first character of fragment 1; once it
+     * is known to be unwanted, fragments are only counted until all are in.
+     * Those buffered before fragment 1 are let go and counted too.
+     */
+    if (ifrag == 1 && !slot->filtered && aivdm_filtered(session, data, datalen)) {
+	unsigned int received;
+
+	for (received = slot->received; received != 0; received &= received - 1)
+	    aivdm_reject(session, AIS_REJECT_FILTERED);
+	slot->filtered = true;
+	slot->payload_used = 0;
+    }
+    if (slot->filtered) {
+	aivdm_reject(session, AIS_REJECT_FILTERED);
+	slot->nfrags = nfrags;
+	slot->received |= 1u << (ifrag - 1);
+	if (slot->received == (1u << nfrags) - 1) {
+	    slot->filtered = false;
+	    slot->received = 0;
+	    aivdm_release(session, slot);
 	}
-#endif
-        /* clear waiting fragments count */
-        ais_context->decoded_frags = 0;
+	return NULL;
+    }
 
-	/* decode the assembled binary packet */
-	return ais_binary_decode(session->context->debug,
-				 ais,
-				 ais_context->bits,
-				 ais_context->bitlen,
-				 split24 ? NULL : &ais_context->type24_queue);
+    if (slot->payload_used + datalen > sizeof(slot->payload)) {
+	gpsd_report(session->context->debug, LOG_INF,
+		    "overlong AIVDM payload truncated.\n");
+	aivdm_drop(session, slot);
+	aivdm_reject(session, AIS_REJECT_PAYLOAD);
+	session->driver.aivdm.stats.reassembly.dropped++;
+	aivdm_release(session, slot);
+	return NULL;
     }
 
-    /* we're still waiting on another sentence */
-    ais_context->decoded_frags++;
-    return false;
+    /* buffer the fragment; the message is complete once all are in */
+    slot->nfrags = nfrags;
+    slot->received |= 1u << (ifrag - 1);
+    slot->start[ifrag - 1] = (unsigned short)slot->payload_used;
+    slot->len[ifrag - 1] = (unsigned short)datalen;
+    slot->pad[ifrag - 1] = pad;
+    (void)memcpy(slot->payload + slot->payload_used, data, datalen);
+    slot->payload_used += datalen;
+    if (slot->received != (1u << nfrags) - 1)
+	return NULL;
+
+    /*
+     * The slot is free again, and its fragments no longer count as
+     * buffered, but its payload stays intact until reused.
+     */
+    session->driver.aivdm.stats.reassembly.completed++;
+    aivdm_release(session, slot);
+    slot->received = 0;
+    for (i = 0; i < nfrags; i++) {
+	frags[i] = slot->payload + slot->start[i];
+	fraglen[i] = slot->len[i];
+    }
+    return aivdm_build(session, frags, fraglen, slot->pad, nfrags);
+}
+
+static unsigned long long aivdm_nsec(void)
+/* monotonic clock for timing decodes, in nanoseconds */
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void aivdm_count(struct gps_device_t *session,
+			const struct aivdm_context_t *ais_context,
+			bool decoded)
+/* count an assembled message as decoded or not, by its type */
+{
+    unsigned int type = ais_context->bits[0] >> 2;
+
+    if (decoded)
+	session->driver.aivdm.stats.decoded[type]++;
+    else
+	session->driver.aivdm.stats.undecoded[type]++;
+}
+
+static void aivdm_timed(struct gps_device_t *session, unsigned long long start)
+/* add a sampled decode time to the histogram */
+{
+    struct ais_stats_t *stats = &session->driver.aivdm.stats;
+    unsigned long long nsec = aivdm_nsec() - start;
+    unsigned int bucket;
+
+    for (bucket = 0; bucket < AIS_TIME_BUCKETS - 1
+	     && nsec >= (64ull << bucket); bucket++)
+	continue;
+    stats->time_histogram[bucket]++;
+    stats->timed++;
+    stats->timed_nsec += nsec;
+}
+
+static bool aivdm_decode_ais(const char *buf, size_t buflen,
+			     struct gps_device_t *session,
+			     struct ais_t *ais,
+			     bool split24)
+{
+    struct aivdm_context_t *ais_context = aivdm_assemble(buf, buflen, session);
+    bool decoded;
+
+    if (ais_context == NULL)
+	return false;
+
+    /* decode the assembled binary packet */
+    decoded = ais_binary_decode(session->context->debug,
+				ais,
+				ais_context->bits,
+				ais_context->bitlen,
+				split24 ? NULL : &session->driver.aivdm.type24_queue[
+				    session->driver.aivdm.ais_channel == 'B'],
+				session->driver.aivdm.skip_fields);
+    aivdm_count(session, ais_context, decoded);
+    if (decoded && session->driver.aivdm.vessels != NULL)
+	(void)ais_vessel_update(session->driver.aivdm.vessels, ais,
+				session->driver.aivdm.skip_fields);
+    return decoded;
+}
+
+bool aivdm_decode(const char *buf, size_t buflen,
+		  struct gps_device_t *session,
+		  struct ais_t *ais,
+		  bool split24, int debug)
+{
+    unsigned long long start;
+    bool decoded;
+
+    /* time one sentence in AIS_TIMING_SAMPLE */
+    if (session->driver.aivdm.stats.sentences % AIS_TIMING_SAMPLE != 0)
+	return aivdm_decode_ais(buf, buflen, session, ais, split24);
+    start = aivdm_nsec();
+    decoded = aivdm_decode_ais(buf, buflen, session, ais, split24);
+    aivdm_timed(session, start);
+    return decoded;
+}
+
+static bool aivdm_decode_record(const char *buf, size_t buflen,
+				struct gps_device_t *session,
+				struct ais_position_t *pos)
+{
+    struct aivdm_context_t *ais_context = aivdm_assemble(buf, buflen, session);
+    bool decoded;
+
+    if (ais_context == NULL)
+	return false;
+
+    /* position reports only; the assembled bits go straight to pos */
+    decoded = ais_position_decode(ais_context->bits, ais_context->bitlen, pos);
+    aivdm_count(session, ais_context, decoded);
+    if (decoded && session->driver.aivdm.vessels != NULL)
+	(void)ais_vessel_update_position(session->driver.aivdm.vessels, pos);
+    return decoded;
+}
+
+bool aivdm_decode_position(const char *buf, size_t buflen,
+			   struct gps_device_t *session,
+			   struct ais_position_t *pos)
+{
+    unsigned long long start;
+    bool decoded;
+
+    if (session->driver.aivdm.stats.sentences % AIS_TIMING_SAMPLE != 0)
+	return aivdm_decode_record(buf, buflen, session, pos);
+    start = aivdm_nsec();
+    decoded = aivdm_decode_record(buf, buflen, session, pos);
+    aivdm_timed(session, start);
+    return decoded;
 }
 /*@ +fixedformalarray +usedef +branchstate @*/
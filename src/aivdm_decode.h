@@ -2,6 +2,12 @@
 #define GPSD_AIVDM_H_
 
 #include "ais.h"
+#include "ais_position.h"
+#include "ais_stats.h"
+#include "ais_tagblock.h"
+#include "ais_vessel.h"
+
+#include <stdint.h>
 
 /*
  * For NMEA-conforming receivers this is supposed to be 82, but
@@ -25,19 +31,107 @@ struct ais_type24_queue_t {
 
 /* state for resolving AIVDM decodes */
 struct aivdm_context_t {
-    /* hold context for decoding AIDVM packet sequences */
-    int decoded_frags;		/* for tracking AIDVM parts in a multipart sequence */
-    unsigned char bits[2048];
+    /* a complete message, de-armored for decoding */
+    unsigned char bits[2048];	/* far more than 2048 bits + UBITS_PAD */
     size_t bitlen; /* how many valid bits */
-    struct ais_type24_queue_t type24_queue;
+    size_t bytes_used; /* bytes of bits which may be nonzero */
+};
+
+#define AIVDM_MAX_FRAGS		9	/* the fragment count is one digit */
+#define AIVDM_ARMOR_CHARS	60	/* payload characters per sentence sent */
+#define AIVDM_SLOT_PAYLOAD	512	/* armored characters per message */
+
+/*
+ * A multipart message being reassembled. Fragments are matched by the
+ * source they were fed from, their channel and their sequential message
+ * ID, so interleaved messages from many receivers don't mix. Their
+ * payloads are buffered as received, in any order, and de-armored once
+ * all fragments are in.
+ */
+struct aivdm_slot_t {
+    bool used;
+    bool filtered;		/* of an unwanted type: fragments not kept */
+    unsigned int source;	/* caller-assigned source, e.g. a station */
+    char channel;		/* 'A' or 'B' */
+    char seqid;			/* sequential message ID, '\0' if none */
+    int nfrags;			/* fragments in the message, 0 if none yet */
+    unsigned int received;	/* bit i set: fragment i+1 is buffered */
+    unsigned long stamp;	/* sentence count at the first fragment */
+    unsigned long sentence;	/* same, counting the source's sentences */
+    unsigned long msec;		/* clock at the first fragment */
+    unsigned short start[AIVDM_MAX_FRAGS];	/* fragment offsets in payload */
+    unsigned short len[AIVDM_MAX_FRAGS];
+    unsigned char pad[AIVDM_MAX_FRAGS];		/* padding field, as received */
+    size_t payload_used;
+    unsigned char payload[AIVDM_SLOT_PAYLOAD];
+};
+
+#define AIVDM_SLOT_BITS	6
+#define AIVDM_SLOTS	(1 << AIVDM_SLOT_BITS)	/* multipart messages reassembled at once */
+#define AIVDM_PROBE	8	/* slots a message may hash to */
+#define AIVDM_SOURCE_CLOCKS	128	/* a power of 2, over AIVDM_SLOTS */
+
+/*
+ * The sentences seen from a source, counted while it has incomplete
+ * messages to expire by them. Clocks are hashed by source, and each is
+ * freed with the last slot of its source, so there is always room.
+ */
+struct aivdm_clock_t {
+    unsigned int source;
+    unsigned int slots;		/* slots of the source in use, 0 if free */
+    unsigned long sentences;
+};
+
+/* partial sentence carried between chunks of a byte stream */
+struct aivdm_stream_t {
+    char buf[NMEA_BIG_BUF];
+    size_t len;
+};
+
+/* the time and source of a tag block group, for its later sentences */
+struct aivdm_tag_group_t {
+    unsigned int fields;	/* AIS_TAG_TIME and AIS_TAG_SOURCE */
+    unsigned int id;
+    long long time;
+    char source[AIS_TAG_SOURCE_MAX];
+    size_t source_len;
 };
 
 struct gps_device_t {
   struct {
 #define AIVDM_CHANNELS	2		/* A, B */
     struct {
-      struct aivdm_context_t context[AIVDM_CHANNELS];
+      /* where each complete message is de-armored */
+      struct aivdm_context_t assembly;
+      /* hash table of multipart messages, probed from the key's hash */
+      struct aivdm_slot_t slots[AIVDM_SLOTS];
+      /* sentences seen, overall and by source */
+      unsigned long sentences;
+      struct aivdm_clock_t clocks[AIVDM_SOURCE_CLOCKS];
+      /* the clock, if timeout_msec is set */
+      unsigned long msec;
+      /* expire incomplete messages after these, unless 0 */
+      unsigned long max_sentences;
+      unsigned long timeout_msec;
+      struct ais_stats_t stats;
+      /* reject sentences without a correct *hh checksum */
+      bool verify_checksum;
+      /* source of the sentences being decoded */
+      unsigned int source;
+      /* only fragment 1 may start a multipart message */
+      bool in_order;
+      struct ais_type24_queue_t type24_queue[AIVDM_CHANNELS];
       char ais_channel;
+      struct aivdm_stream_t stream;
+      /* the tag block of the last sentence, if any */
+      struct ais_tagblock_t tagblock;
+      struct aivdm_tag_group_t tag_group;
+      /* updated with every decoded message, if set */
+      struct ais_vessel_table_t *vessels;
+      /* bit n set: don't decode messages of type n */
+      uint64_t skip_types;
+      /* per message type, the layout fields not to decode */
+      uint32_t skip_fields[AIS_MESSAGE_TYPES];
     } aivdm;
   } driver;
   struct gps_context_t {
@@ -45,9 +139,22 @@ struct gps_device_t {
   } *context;
 };
 
+void aivdm_dearmor(unsigned char *bits, size_t *bitlen,
+                   const unsigned char *data, size_t len);
+/* select the SIMD de-armoring kernel, or scalar code; returns its name */
+const char *aivdm_dearmor_select(bool simd);
+/* expire incomplete messages begun before the stamp-th sentence */
+void aivdm_flush(struct gps_device_t *session, unsigned long stamp);
+/* armor a message's bits into CRLF-terminated sentences; their length */
+size_t aivdm_armor(const unsigned char *bits, size_t bitlen,
+                   char channel, unsigned int seqid, char *buf, size_t buflen);
 bool aivdm_decode(const char *buf, size_t buflen,
                   struct gps_device_t *session,
                   struct ais_t *ais,
                   bool split24, int debug);
+/* like aivdm_decode(), for position reports only, into a compact record */
+bool aivdm_decode_position(const char *buf, size_t buflen,
+                           struct gps_device_t *session,
+                           struct ais_position_t *pos);
 
 #endif
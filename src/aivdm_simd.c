@@ -0,0 +1,164 @@
+/*
+ * SIMD kernels for AIVDM payload unpacking; see aivdm_simd.h.
+ *
+ * Each kernel validates that a block only holds armoring characters
+ * ('0'-'W' and '`'-'w'), maps them to 6-bit values (subtract 48, and
+ * another 8 above 'W') and packs every 4 values into 3 big-endian bytes.
+ * The x86 kernels are built with function target attributes and chosen
+ * at runtime by CPU detection, so no special compiler flags are needed.
+ */
+#include "aivdm_simd.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AIVDM_SIMD_X86
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define AIVDM_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+#ifdef AIVDM_SIMD_X86
+__attribute__((target("ssse3"), always_inline))
+static inline __m128i sixbit_sse(__m128i in, bool *bad)
+{
+    /* bytes >= 128 are negative here, so they fail the low bound too */
+    __m128i above_w = _mm_cmpgt_epi8(in, _mm_set1_epi8(87));
+    __m128i invalid = _mm_or_si128(
+	_mm_or_si128(_mm_cmpgt_epi8(_mm_set1_epi8(48), in),
+		     _mm_cmpgt_epi8(in, _mm_set1_epi8(119))),
+	_mm_and_si128(above_w, _mm_cmpgt_epi8(_mm_set1_epi8(96), in)));
+    __m128i v = _mm_sub_epi8(in, _mm_set1_epi8(48));
+
+    *bad = _mm_movemask_epi8(invalid) != 0;
+    return _mm_sub_epi8(v, _mm_and_si128(above_w, _mm_set1_epi8(8)));
+}
+
+/*
+ * Always inlined, so that the AVX2 kernel gets a VEX-encoded copy for its
+ * tail and does not pay for switching between AVX and legacy SSE code.
+ */
+__attribute__((target("ssse3"), always_inline))
+static inline size_t unpack16(unsigned char *out,
+			      const unsigned char *data, size_t len)
+{
+    const __m128i order = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8,
+					14, 13, 12, -1, -1, -1, -1);
+    size_t i = 0;
+
+    /* each step stores 16 bytes, 12 of them output: keep 4 in reserve */
+    for (; len - i >= 16 + 6; i += 16, out += 12) {
+	bool bad;
+	__m128i v = sixbit_sse(_mm_loadu_si128((const __m128i *)(data + i)),
+			       &bad);
+	if (bad)
+	    break;
+	/* aaaaaabbbbbb in 16-bit lanes, then 24-bit values in 32-bit lanes */
+	v = _mm_maddubs_epi16(v, _mm_set1_epi16(0x0140));
+	v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+	_mm_storeu_si128((__m128i *)out, _mm_shuffle_epi8(v, order));
+    }
+    return i;
+}
+
+__attribute__((target("ssse3")))
+static size_t unpack_ssse3(unsigned char *out,
+			   const unsigned char *data, size_t len)
+{
+    return unpack16(out, data, len);
+}
+
+__attribute__((target("avx2")))
+static size_t unpack_avx2(unsigned char *out,
+			  const unsigned char *data, size_t len)
+{
+    const __m256i order = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8,
+					   14, 13, 12, -1, -1, -1, -1,
+					   2, 1, 0, 6, 5, 4, 10, 9, 8,
+					   14, 13, 12, -1, -1, -1, -1);
+    const __m256i compact = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+    size_t i = 0;
+
+    /* each step stores 32 bytes, 24 of them output: keep 8 in reserve */
+    for (; len - i >= 32 + 11; i += 32, out += 24) {
+	__m256i in = _mm256_loadu_si256((const __m256i *)(data + i));
+	__m256i above_w = _mm256_cmpgt_epi8(in, _mm256_set1_epi8(87));
+	__m256i invalid = _mm256_or_si256(
+	    _mm256_or_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(48), in),
+			    _mm256_cmpgt_epi8(in, _mm256_set1_epi8(119))),
+	    _mm256_and_si256(above_w,
+			     _mm256_cmpgt_epi8(_mm256_set1_epi8(96), in)));
+	__m256i v;
+
+	if (_mm256_movemask_epi8(invalid) != 0)
+	    break;
+	v = _mm256_sub_epi8(in, _mm256_set1_epi8(48));
+	v = _mm256_sub_epi8(v, _mm256_and_si256(above_w, _mm256_set1_epi8(8)));
+	v = _mm256_maddubs_epi16(v, _mm256_set1_epi16(0x0140));
+	v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+	v = _mm256_shuffle_epi8(v, order);
+	/* move the 12 output bytes of the high lane next to the low lane's */
+	v = _mm256_permutevar8x32_epi32(v, compact);
+	_mm256_storeu_si256((__m256i *)out, v);
+    }
+    /* finish shorter runs 16 characters at a time */
+    return i + unpack16(out, data + i, len - i);
+}
+#endif /* AIVDM_SIMD_X86 */
+
+#ifdef AIVDM_SIMD_NEON
+static size_t unpack_neon(unsigned char *out,
+			  const unsigned char *data, size_t len)
+{
+    size_t i = 0;
+
+    /* 32 characters, de-interleaved into 4 lanes, make 24 bytes */
+    for (; len - i >= 32; i += 32, out += 24) {
+	uint8x8x4_t in = vld4_u8(data + i);
+	uint8x8x3_t packed;
+	uint8x8_t v[4], invalid = vdup_n_u8(0);
+	int k;
+
+	for (k = 0; k < 4; k++) {
+	    uint8x8_t c = in.val[k];
+	    uint8x8_t above_w = vcgt_u8(c, vdup_n_u8(87));
+	    invalid = vorr_u8(invalid, vclt_u8(c, vdup_n_u8(48)));
+	    invalid = vorr_u8(invalid, vcgt_u8(c, vdup_n_u8(119)));
+	    invalid = vorr_u8(invalid,
+			      vand_u8(above_w, vclt_u8(c, vdup_n_u8(96))));
+	    v[k] = vsub_u8(vsub_u8(c, vdup_n_u8(48)),
+			   vand_u8(above_w, vdup_n_u8(8)));
+	}
+	if (vmaxv_u8(invalid) != 0)
+	    break;
+	packed.val[0] = vorr_u8(vshl_n_u8(v[0], 2), vshr_n_u8(v[1], 4));
+	packed.val[1] = vorr_u8(vshl_n_u8(v[1], 4), vshr_n_u8(v[2], 2));
+	packed.val[2] = vorr_u8(vshl_n_u8(v[2], 6), v[3]);
+	vst3_u8(out, packed);
+    }
+    return i;
+}
+#endif /* AIVDM_SIMD_NEON */
+
+aivdm_unpack_fn aivdm_unpack_select(const char **name)
+{
+#ifdef AIVDM_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+	*name = "avx2";
+	return unpack_avx2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+	*name = "ssse3";
+	return unpack_ssse3;
+    }
+#endif
+#ifdef AIVDM_SIMD_NEON
+    *name = "neon";
+    return unpack_neon;
+#endif
+    *name = "scalar";
+    return NULL;
+}
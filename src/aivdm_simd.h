@@ -0,0 +1,19 @@
+#ifndef GPSD_AIVDM_SIMD_H_
+#define GPSD_AIVDM_SIMD_H_
+
+#include <stddef.h>
+
+/*
+ * Vectorized AIVDM payload unpacking. A kernel converts whole blocks of
+ * armored characters to packed 6-bit binary at out, which must be byte
+ * aligned, and returns the number of characters consumed. It stops at
+ * the first block containing a character outside the armoring alphabet,
+ * and never writes past the packed size of data[0..len).
+ */
+typedef size_t (*aivdm_unpack_fn)(unsigned char *out,
+				  const unsigned char *data, size_t len);
+
+/* the fastest kernel this CPU supports, or NULL if none; sets *name */
+aivdm_unpack_fn aivdm_unpack_select(const char **name);
+
+#endif
@@ -8,7 +8,8 @@
  * 64 bits.
  *
  * The sbits() function assumes twos-complement arithmetic. ubits()
- * and sbits() assume no padding in integers.
+ * and sbits() assume no padding in integers. Both wrap the inline
+ * extractors in bits.h, and read up to UBITS_PAD bytes past the field.
  */
 #include <assert.h>
 #include <stdint.h>
@@ -20,42 +21,10 @@
 uint64_t ubits(unsigned char buf[], unsigned int start, unsigned int width, bool le)
 /* extract a (zero-origin) bitfield from the buffer as an unsigned big-endian uint64_t */
 {
-    uint64_t fld = 0;
-    unsigned int i;
-    unsigned end;
-
     /*@i1@*/ assert(width <= sizeof(uint64_t) * CHAR_BIT);
-    for (i = start / CHAR_BIT;
-	 i < (start + width + CHAR_BIT - 1) / CHAR_BIT; i++) {
-	/*@i1@*/fld <<= CHAR_BIT;
-	fld |= (unsigned char)buf[i];
-    }
-
-    end = (start + width) % CHAR_BIT;
-    if (end != 0) {
-	/*@i1@*/fld >>= (CHAR_BIT - end);
-    }
-
-    /*@ -shiftimplementation @*/
-    fld &= ~(-1LL << width);
-    /*@ +shiftimplementation @*/
-
-    /* was extraction as a little-endian requested? */
-    if (le)
-    {
-	uint64_t reversed = 0;
-
-	for (i = width; i; --i)
-	{
-	    reversed <<= 1;
-	    if (fld & 1)
-		reversed |= 1;
-	    fld >>= 1;
-	}
-	fld = reversed;
-    }
-
-    return fld;
+    if (width == 0)
+	return 0;
+    return le ? ubits_le(buf, start, width) : ubits_be(buf, start, width);
 }
 
 int64_t sbits(signed char buf[], unsigned int start, unsigned int width, bool le)
@@ -15,6 +15,7 @@
 #define _GPSD_BITS_H_
 
 #include <stdint.h>
+#include <string.h>
 
 /* these are independent of byte order */
 #define getsb(buf, off)	((int8_t)buf[off])
@@ -50,6 +51,83 @@ extern double getbed64(const char *, int);
 extern void putbef32(char *, int, float);
 extern void putbed64(char *, int, double);
 
+/*
+ * Inline bitfield extraction. start is a bit index and width is 1..64.
+ * One unaligned 8-byte load covers the field (a 9th byte is read only
+ * when the field needs it), so buffers must have UBITS_PAD readable
+ * bytes after the last byte any extracted field touches.
+ */
+#define UBITS_PAD	8
+
+static inline uint64_t getbeu64_unaligned(const unsigned char *p)
+{
+    uint64_t w;
+
+    memcpy(&w, p, sizeof(w));
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && \
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    w = __builtin_bswap64(w);
+#elif !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_BIG_ENDIAN__
+    w = getbeu64(p, 0);
+#endif
+    return w;
+}
+
+static inline uint64_t ubits_be(const unsigned char *buf,
+				unsigned int start, unsigned int width)
+/* extract a big-endian bitfield */
+{
+    const unsigned char *p = buf + start / 8;
+    unsigned int shift = start % 8;
+    uint64_t fld = getbeu64_unaligned(p) << shift;
+
+    if (shift + width > 64)
+	fld |= (uint64_t)p[8] >> (8 - shift);
+    return fld >> (64 - width);
+}
+
+static inline int64_t sbits_be(const unsigned char *buf,
+			       unsigned int start, unsigned int width)
+/* extract a big-endian bitfield, sign-extended from its top bit */
+{
+    uint64_t fld = ubits_be(buf, start, width) << (64 - width);
+
+    return (int64_t)fld >> (64 - width);
+}
+
+static inline uint64_t ubits_le(const unsigned char *buf,
+				unsigned int start, unsigned int width)
+/* extract a bitfield with its bit order reversed (least significant first) */
+{
+    uint64_t fld = ubits_be(buf, start, width) << (64 - width);
+
+    /* reverse all 64 bits; the field ends up in the low width bits */
+    fld = ((fld >> 1) & 0x5555555555555555ULL) | ((fld & 0x5555555555555555ULL) << 1);
+    fld = ((fld >> 2) & 0x3333333333333333ULL) | ((fld & 0x3333333333333333ULL) << 2);
+    fld = ((fld >> 4) & 0x0f0f0f0f0f0f0f0fULL) | ((fld & 0x0f0f0f0f0f0f0f0fULL) << 4);
+    fld = ((fld >> 8) & 0x00ff00ff00ff00ffULL) | ((fld & 0x00ff00ff00ff00ffULL) << 8);
+    fld = ((fld >> 16) & 0x0000ffff0000ffffULL) | ((fld & 0x0000ffff0000ffffULL) << 16);
+    return (fld >> 32) | (fld << 32);
+}
+
+static inline void putbits_be(unsigned char *buf, unsigned int start,
+			      unsigned int width, uint64_t value)
+/* store the low width bits of value as a big-endian bitfield; buf must
+ * be clear there, as the bits are ORed in */
+{
+    if (width < 64)
+	value &= ((uint64_t)1 << width) - 1;
+    while (width > 0) {
+	unsigned int shift = start % 8;
+	unsigned int n = 8 - shift < width ? 8 - shift : width;
+
+	buf[start / 8] |= (unsigned char)
+	    (((value >> (width - n)) & ((1u << n) - 1)) << (8 - shift - n));
+	start += n;
+	width -= n;
+    }
+}
+
 /* bitfield extraction */
 extern uint64_t ubits(unsigned char buf[], unsigned int, unsigned int, bool);
 extern int64_t sbits(signed char buf[], unsigned int, unsigned int, bool);
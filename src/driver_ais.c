@@ -15,12 +15,15 @@
  * This file is Copyright (c) 2010 by the GPSD project
  * BSD terms apply: see the file COPYING in the distribution root for details.
  */
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 
 #include "gpsd.h"
 #include "bits.h"
+#include "ais_layout.h"
+#include "driver_ais.h"
 
 /*
  * Parse the data from the device
@@ -42,7 +45,7 @@ static void from_sixbit(unsigned char *bitvec, uint start, int count, char *to)
 
     /* six-bit to ASCII */
     for (i = 0; i < count; i++) {
-	newchar = sixchr[ubits(bitvec, start + 6 * i, 6U, false)];
+	newchar = sixchr[ubits_be(bitvec, start + 6 * i, 6U)];
 	if (newchar == '@')
 	    break;
 	else
@@ -58,25 +61,93 @@ static void from_sixbit(unsigned char *bitvec, uint start, int count, char *to)
     /*@ -type @*/
 }
 
+static void to_sixbit(unsigned char *bitvec, uint start, int count,
+		      const char *from)
+/* beginning at bitvec bit start, pack up to count sixbit characters */
+{
+    int i, c;
+
+    /* ASCII to six-bit; the rest of the field stays '@' (0) */
+    for (i = 0; i < count && from[i] != '\0'; i++) {
+	c = toupper((unsigned char)from[i]);
+	if (c >= '@' && c <= '_')
+	    c -= '@';
+	else if (c < ' ' || c > '?')
+	    c = ' ';		/* not in the character set */
+	putbits_be(bitvec, start + 6 * i, 6U, (uint64_t)c);
+    }
+}
+
+static size_t ais_type_size(const struct ais_t *ais, unsigned int type)
+/* size of the part of the ais_t union used by a message type */
+{
+    switch (type) {
+    case 1: case 2: case 3:	return sizeof(ais->type1);
+    case 4: case 11:		return sizeof(ais->type4);
+    case 5:			return sizeof(ais->type5);
+    case 6:			return sizeof(ais->type6);
+    case 7: case 13:		return sizeof(ais->type7);
+    case 8:			return sizeof(ais->type8);
+    case 9:			return sizeof(ais->type9);
+    case 10:			return sizeof(ais->type10);
+    case 12:			return sizeof(ais->type12);
+    case 14:			return sizeof(ais->type14);
+    case 15:			return sizeof(ais->type15);
+    case 16:			return sizeof(ais->type16);
+    case 17:			return sizeof(ais->type17);
+    case 18:			return sizeof(ais->type18);
+    case 19:			return sizeof(ais->type19);
+    case 20:			return sizeof(ais->type20);
+    case 21:			return sizeof(ais->type21);
+    case 22:			return sizeof(ais->type22);
+    case 23:			return sizeof(ais->type23);
+    case 24:			return sizeof(ais->type24);
+    case 25:			return sizeof(ais->type25);
+    case 26:			return sizeof(ais->type26);
+    case 27:			return sizeof(ais->type27);
+    default:			return 0;
+    }
+}
+
 /*@ +charint @*/
 bool ais_binary_decode(const int debug,
 		       struct ais_t *ais,
 		       const unsigned char *bits, size_t bitlen,
-		       struct ais_type24_queue_t *type24_queue)
-/* decode an AIS binary packet */
+		       struct ais_type24_queue_t *type24_queue,
+		       const uint32_t *skip_fields)
+/* decode an AIS binary packet, leaving out the layout fields in skip_fields */
 {
     bool structured;
     unsigned int u;
     int i;
+    uint32_t skip = 0;
 
 #define BITS_PER_BYTE	8
-#define UBITS(s, l)	ubits((unsigned char *)bits, s, l, false)
-#define SBITS(s, l)	sbits((signed char *)bits, s, l, false)
+#define UBITS(s, l)	ubits_be(bits, s, l)
+#define SBITS(s, l)	sbits_be(bits, s, l)
 #define UCHARS(s, to)	from_sixbit((unsigned char *)bits, s, sizeof(to)-1, to)
 #define ENDCHARS(s, to)	from_sixbit((unsigned char *)bits, s, (bitlen-(s))/6,to)
+/* expand a field of an ais_layout.h list into its extraction */
+#define AIS_DECODE_U(group, member, s, l)	ais->group.member = UBITS(s, l);
+#define AIS_DECODE_S(group, member, s, l)	ais->group.member = SBITS(s, l);
+#define AIS_DECODE_B(group, member, s, l)	ais->group.member = UBITS(s, l)!=0;
+#define AIS_DECODE_C(group, member, s, l) \
+	from_sixbit((unsigned char *)bits, s, l, ais->group.member);
+#define AIS_DECODE(kind, group, member, s, l) \
+	if ((skip & AIS_FIELD_BIT(group, member)) == 0) { \
+	    AIS_DECODE_##kind(group, member, s, l) \
+	}
+    /*
+     * Clear the header and the part of the union this type uses, rather
+     * than the whole ais_t, which is sized by the largest binary messages.
+     */
+    (void)memset(ais, 0,
+		 offsetof(struct ais_t, type1) + ais_type_size(ais, UBITS(0, 6)));
     ais->type = UBITS(0, 6);
     ais->repeat = UBITS(6, 2);
     ais->mmsi = UBITS(8, 30);
+    if (skip_fields != NULL && ais->type < AIS_MESSAGE_TYPES)
+	skip = skip_fields[ais->type];
     gpsd_report(debug, LOG_INF,
 		"AIVDM message type %d, MMSI %09d:\n",
 		ais->type, ais->mmsi);
@@ -90,52 +161,28 @@ bool ais_binary_decode(const int debug,
     case 1:	/* Position Report */
     case 2:
     case 3:
-	if (bitlen != 168) {
+	if (bitlen != AIS_TYPE1_BITS) {
 	    gpsd_report(debug, LOG_WARN, 
 			"AIVDM message type %d size not 168 bits (%zd).\n",
 			ais->type,
 			bitlen);
-	    if (bitlen < 168) return false;
+	    if (bitlen < AIS_TYPE1_BITS) return false;
 	}
-	ais->type1.status	= UBITS(38, 4);
-	ais->type1.turn		= SBITS(42, 8);
-	ais->type1.speed	= UBITS(50, 10);
-	ais->type1.accuracy	= UBITS(60, 1)!=0;
-	ais->type1.lon		= SBITS(61, 28);
-	ais->type1.lat		= SBITS(89, 27);
-	ais->type1.course	= UBITS(116, 12);
-	ais->type1.heading	= UBITS(128, 9);
-	ais->type1.second	= UBITS(137, 6);
-	ais->type1.maneuver	= UBITS(143, 2);
-	//ais->type1.spare	= UBITS(145, 3);
-	ais->type1.raim		= UBITS(148, 1)!=0;
-	ais->type1.radio	= UBITS(149, 19);
+	AIS_TYPE1_FIELDS(AIS_DECODE)
 	break;
     case 4: 	/* Base Station Report */
     case 11:	/* UTC/Date Response */
-	if (bitlen != 168) {
+	if (bitlen != AIS_TYPE4_BITS) {
 	    gpsd_report(debug, LOG_WARN, 
 			"AIVDM message type %d size not 168 bits (%zd).\n",
 			ais->type,
 			bitlen);
-	    if (bitlen < 168) return false;
+	    if (bitlen < AIS_TYPE4_BITS) return false;
 	}
-	ais->type4.year		= UBITS(38, 14);
-	ais->type4.month	= UBITS(52, 4);
-	ais->type4.day		= UBITS(56, 5);
-	ais->type4.hour		= UBITS(61, 5);
-	ais->type4.minute	= UBITS(66, 6);
-	ais->type4.second	= UBITS(72, 6);
-	ais->type4.accuracy	= UBITS(78, 1)!=0;
-	ais->type4.lon		= SBITS(79, 28);
-	ais->type4.lat		= SBITS(107, 27);
-	ais->type4.epfd		= UBITS(134, 4);
-	//ais->type4.spare	= UBITS(138, 10);
-	ais->type4.raim		= UBITS(148, 1)!=0;
-	ais->type4.radio	= UBITS(149, 19);
+	AIS_TYPE4_FIELDS(AIS_DECODE)
 	break;
     case 5: /* Ship static and voyage related data */
-	if (bitlen != 424) {
+	if (bitlen != AIS_TYPE5_BITS) {
 	    gpsd_report(debug, LOG_WARN,
 			"AIVDM message type 5 size not 424 bits (%zd).\n",
 			bitlen);
@@ -146,22 +193,7 @@ bool ais_binary_decode(const int debug,
 	    if (bitlen < 420)
 		return false;
 	}
-	ais->type5.ais_version  = UBITS(38, 2);
-	ais->type5.imo          = UBITS(40, 30);
-	UCHARS(70, ais->type5.callsign);
-	UCHARS(112, ais->type5.shipname);
-	ais->type5.shiptype     = UBITS(232, 8);
-	ais->type5.to_bow       = UBITS(240, 9);
-	ais->type5.to_stern     = UBITS(249, 9);
-	ais->type5.to_port      = UBITS(258, 6);
-	ais->type5.to_starboard = UBITS(264, 6);
-	ais->type5.epfd         = UBITS(270, 4);
-	ais->type5.month        = UBITS(274, 4);
-	ais->type5.day          = UBITS(278, 5);
-	ais->type5.hour         = UBITS(283, 5);
-	ais->type5.minute       = UBITS(288, 6);
-	ais->type5.draught      = UBITS(294, 8);
-	UCHARS(302, ais->type5.destination);
+	AIS_TYPE5_FIELDS(AIS_DECODE)
 	if (bitlen >= 423)
 	    ais->type5.dte          = UBITS(422, 1);
 	//ais->type5.spare        = UBITS(423, 1);
@@ -718,36 +750,22 @@ bool ais_binary_decode(const int debug,
 			 (ais->type8.bitcount + 7) / 8);
 	break;
     case 9: /* Standard SAR Aircraft Position Report */
-	if (bitlen != 168) {
+	if (bitlen != AIS_TYPE9_BITS) {
 	    gpsd_report(debug, LOG_WARN,
 			"AIVDM message type 9 size not 168 bits (%zd).\n",
 			bitlen);
-	    if (bitlen < 168) return false;
+	    if (bitlen < AIS_TYPE9_BITS) return false;
 	}
-	ais->type9.alt		= UBITS(38, 12);
-	ais->type9.speed		= UBITS(50, 10);
-	ais->type9.accuracy		= (bool)UBITS(60, 1);
-	ais->type9.lon		= SBITS(61, 28);
-	ais->type9.lat		= SBITS(89, 27);
-	ais->type9.course		= UBITS(116, 12);
-	ais->type9.second		= UBITS(128, 6);
-	ais->type9.regional		= UBITS(134, 8);
-	ais->type9.dte		= UBITS(142, 1);
-	//ais->type9.spare		= UBITS(143, 3);
-	ais->type9.assigned		= UBITS(146, 1)!=0;
-	ais->type9.raim		= UBITS(147, 1)!=0;
-	ais->type9.radio		= UBITS(148, 19);
+	AIS_TYPE9_FIELDS(AIS_DECODE)
 	break;
     case 10: /* UTC/Date inquiry */
-	if (bitlen != 72) {
+	if (bitlen != AIS_TYPE10_BITS) {
 	    gpsd_report(debug, LOG_WARN,
 			"AIVDM message type 10 size not 72 bits (%zd).\n",
 			bitlen);
-	    if (bitlen < 72) return false;
+	    if (bitlen < AIS_TYPE10_BITS) return false;
 	}
-	//ais->type10.spare        = UBITS(38, 2);
-	ais->type10.dest_mmsi      = UBITS(40, 30);
-	//ais->type10.spare2       = UBITS(70, 2);
+	AIS_TYPE10_FIELDS(AIS_DECODE)
 	break;
     case 12: /* Safety Related Message */
 	if (bitlen < 72 || bitlen > 1008) {
@@ -833,108 +851,40 @@ bool ais_binary_decode(const int debug,
 		     (ais->type17.bitcount + 7) / 8);
 	break;
     case 18:	/* Standard Class B CS Position Report */
-	if (bitlen != 168) {
+	if (bitlen != AIS_TYPE18_BITS) {
 	    gpsd_report(debug, LOG_WARN,
 			"AIVDM message type 18 size not 168 bits (%zd).\n",
 			bitlen);
-	    if (bitlen < 168) return false;
+	    if (bitlen < AIS_TYPE18_BITS) return false;
 	}
-	ais->type18.reserved	= UBITS(38, 8);
-	ais->type18.speed		= UBITS(46, 10);
-	ais->type18.accuracy	= UBITS(56, 1)!=0;
-	ais->type18.lon		= SBITS(57, 28);
-	ais->type18.lat		= SBITS(85, 27);
-	ais->type18.course		= UBITS(112, 12);
-	ais->type18.heading		= UBITS(124, 9);
-	ais->type18.second		= UBITS(133, 6);
-	ais->type18.regional	= UBITS(139, 2);
-	ais->type18.cs		= UBITS(141, 1)!=0;
-	ais->type18.display 	= UBITS(142, 1)!=0;
-	ais->type18.dsc     	= UBITS(143, 1)!=0;
-	ais->type18.band    	= UBITS(144, 1)!=0;
-	ais->type18.msg22   	= UBITS(145, 1)!=0;
-	ais->type18.assigned	= UBITS(146, 1)!=0;
-	ais->type18.raim		= UBITS(147, 1)!=0;
-	ais->type18.radio		= UBITS(148, 20);
+	AIS_TYPE18_FIELDS(AIS_DECODE)
 	break;
     case 19:	/* Extended Class B CS Position Report */
-	if (bitlen != 312) {
+	if (bitlen != AIS_TYPE19_BITS) {
 	    gpsd_report(debug, LOG_WARN,
 			"AIVDM message type 19 size not 312 bits (%zd).\n",
 			bitlen);
-	    if (bitlen < 312) return false;
+	    if (bitlen < AIS_TYPE19_BITS) return false;
 	}
-	ais->type19.reserved     = UBITS(38, 8);
-	ais->type19.speed        = UBITS(46, 10);
-	ais->type19.accuracy     = UBITS(56, 1)!=0;
-	ais->type19.lon          = SBITS(57, 28);
-	ais->type19.lat          = SBITS(85, 27);
-	ais->type19.course       = UBITS(112, 12);
-	ais->type19.heading      = UBITS(124, 9);
-	ais->type19.second       = UBITS(133, 6);
-	ais->type19.regional     = UBITS(139, 4);
-	UCHARS(143, ais->type19.shipname);
-	ais->type19.shiptype     = UBITS(263, 8);
-	ais->type19.to_bow       = UBITS(271, 9);
-	ais->type19.to_stern     = UBITS(280, 9);
-	ais->type19.to_port      = UBITS(289, 6);
-	ais->type19.to_starboard = UBITS(295, 6);
-	ais->type19.epfd         = UBITS(301, 4);
-	ais->type19.raim         = UBITS(305, 1)!=0;
-	ais->type19.dte          = UBITS(306, 1)!=0;
-	ais->type19.assigned     = UBITS(307, 1)!=0;
-	//ais->type19.spare      = UBITS(308, 4);
+	AIS_TYPE19_FIELDS(AIS_DECODE)
 	break;
     case 20:	/* Data Link Management Message */
-	if (bitlen < 72 || bitlen > 160) {
+	if (bitlen < 72 || bitlen > AIS_TYPE20_BITS) {
 	    gpsd_report(debug, LOG_WARN,
 			"AIVDM message type 20 size is out of range (%zd).\n",
 			bitlen);
 	    return false;
 	}
-	//ais->type20.spare		= UBITS(38, 2);
-	ais->type20.offset1		= UBITS(40, 12);
-	ais->type20.number1		= UBITS(52, 4);
-	ais->type20.timeout1	= UBITS(56, 3);
-	ais->type20.increment1	= UBITS(59, 11);
-	ais->type20.offset2		= UBITS(70, 12);
-	ais->type20.number2		= UBITS(82, 4);
-	ais->type20.timeout2	= UBITS(86, 3);
-	ais->type20.increment2	= UBITS(89, 11);
-	ais->type20.offset3		= UBITS(100, 12);
-	ais->type20.number3		= UBITS(112, 4);
-	ais->type20.timeout3	= UBITS(116, 3);
-	ais->type20.increment3	= UBITS(119, 11);
-	ais->type20.offset4		= UBITS(130, 12);
-	ais->type20.number4		= UBITS(142, 4);
-	ais->type20.timeout4	= UBITS(146, 3);
-	ais->type20.increment4	= UBITS(149, 11);
+	AIS_TYPE20_FIELDS(AIS_DECODE)
 	break;
     case 21:	/* Aid-to-Navigation Report */
-	if (bitlen < 272 || bitlen > 360) {
+	if (bitlen < AIS_TYPE21_BITS || bitlen > 360) {
 	    gpsd_report(debug, LOG_WARN,
 			"AIVDM message type 21 size is out of range (%zd).\n",
 			bitlen);
 	    return false;
 	}
-	ais->type21.aid_type = UBITS(38, 5);
-	from_sixbit((unsigned char *)bits,
-		    43, 20, ais->type21.name);
-	ais->type21.accuracy     = UBITS(163, 1);
-	ais->type21.lon          = SBITS(164, 28);
-	ais->type21.lat          = SBITS(192, 27);
-	ais->type21.to_bow       = UBITS(219, 9);
-	ais->type21.to_stern     = UBITS(228, 9);
-	ais->type21.to_port      = UBITS(237, 6);
-	ais->type21.to_starboard = UBITS(243, 6);
-	ais->type21.epfd         = UBITS(249, 4);
-	ais->type21.second       = UBITS(253, 6);
-	ais->type21.off_position = UBITS(259, 1)!=0;
-	ais->type21.regional     = UBITS(260, 8);
-	ais->type21.raim         = UBITS(268, 1)!=0;
-	ais->type21.virtual_aid  = UBITS(269, 1)!=0;
-	ais->type21.assigned     = UBITS(270, 1)!=0;
-	//ais->type21.spare      = UBITS(271, 1);
+	AIS_TYPE21_FIELDS(AIS_DECODE)
 	if (strlen(ais->type21.name) == 20 && bitlen > 272)
 	    ENDCHARS(272, ais->type21.name+20);
 	break;
@@ -964,21 +914,13 @@ bool ais_binary_decode(const int debug,
 	ais->type22.zonesize     = UBITS(142, 3);
 	break;
     case 23:	/* Group Assignment Command */
-	if (bitlen != 160) {
+	if (bitlen != AIS_TYPE23_BITS) {
 	    gpsd_report(debug, LOG_WARN,
 			"AIVDM message type 23 size not 160 bits (%zd).\n",
 			bitlen);
-	    if (bitlen < 160) return false;
+	    if (bitlen < AIS_TYPE23_BITS) return false;
 	}
-	ais->type23.ne_lon       = SBITS(40, 18);
-	ais->type23.ne_lat       = SBITS(58, 17);
-	ais->type23.sw_lon       = SBITS(75, 18);
-	ais->type23.sw_lat       = SBITS(93, 17);
-	ais->type23.stationtype  = UBITS(110, 4);
-	ais->type23.shiptype     = UBITS(114, 8);
-	ais->type23.txrx         = UBITS(144, 4);
-	ais->type23.interval     = UBITS(146, 4);
-	ais->type23.quiet        = UBITS(150, 4);
+	AIS_TYPE23_FIELDS(AIS_DECODE)
 	break;
     case 24:	/* Class B CS Static Data Report */
 	switch (UBITS(38, 2)) {
@@ -1136,7 +1078,7 @@ bool ais_binary_decode(const int debug,
 		     (ais->type26.bitcount + 7) / 8);
 	break;
     case 27:	/* Long Range AIS Broadcast message */
-	if (bitlen != 96 && bitlen != 168) {
+	if (bitlen != AIS_TYPE27_BITS && bitlen != 168) {
 	    gpsd_report(debug, LOG_WARN,
 			"unexpected AIVDM message type 27 (%zd).\n",
 			bitlen);
@@ -1149,14 +1091,7 @@ bool ais_binary_decode(const int debug,
 	    gpsd_report(debug, LOG_WARN,
 			"oversized 169=8-bit AIVDM message type 27.\n");
 	}
-	ais->type27.accuracy        = (bool)UBITS(38, 1);
-	ais->type27.raim		= UBITS(39, 1)!=0;
-	ais->type27.status		= UBITS(40, 4);
-	ais->type27.lon		= SBITS(44, 18);
-	ais->type27.lat		= SBITS(62, 17);
-	ais->type27.speed		= UBITS(79, 6);
-	ais->type27.course		= UBITS(85, 9);
-	ais->type27.gnss            = (bool)UBITS(94, 1);
+	AIS_TYPE27_FIELDS(AIS_DECODE)
 	break;
     default:
 	gpsd_report(debug, LOG_ERROR,
@@ -1164,6 +1099,12 @@ bool ais_binary_decode(const int debug,
 	return false;
     }
     /* *INDENT-ON* */
+#undef AIS_DECODE
+#undef AIS_DECODE_C
+#undef AIS_DECODE_B
+#undef AIS_DECODE_S
+#undef AIS_DECODE_U
+#undef ENDCHARS
 #undef UCHARS
 #undef SBITS
 #undef UBITS
@@ -1172,6 +1113,228 @@ bool ais_binary_decode(const int debug,
     /* data is fully decoded */
     return true;
 }
+
+bool ais_binary_encode(const struct ais_t *ais,
+		       unsigned char *bits, size_t *bitlen)
+/* encode an AIS message into bits, AIS_ENCODE_BYTES long */
+{
+    size_t n, len;
+
+#define PUTBITS(s, l, v)	putbits_be(bits, s, l, (uint64_t)(v))
+/* expand a field of an ais_layout.h list into its insertion */
+#define AIS_ENCODE_U(group, member, s, l)	PUTBITS(s, l, ais->group.member);
+#define AIS_ENCODE_S(group, member, s, l) \
+	PUTBITS(s, l, (int64_t)ais->group.member);
+#define AIS_ENCODE_B(group, member, s, l) \
+	PUTBITS(s, l, ais->group.member ? 1 : 0);
+#define AIS_ENCODE_C(group, member, s, l) \
+	to_sixbit(bits, s, l, ais->group.member);
+#define AIS_ENCODE(kind, group, member, s, l) \
+	AIS_ENCODE_##kind(group, member, s, l)
+    (void)memset(bits, 0, AIS_ENCODE_BYTES);
+    PUTBITS(0, 6, ais->type);
+    PUTBITS(6, 2, ais->repeat);
+    PUTBITS(8, 30, ais->mmsi);
+
+    /* *INDENT-OFF* */
+    switch (ais->type) {
+    case 1:	/* Position Report */
+    case 2:
+    case 3:
+	AIS_TYPE1_FIELDS(AIS_ENCODE)
+	n = AIS_TYPE1_BITS;
+	break;
+    case 4: 	/* Base Station Report */
+    case 11:	/* UTC/Date Response */
+	AIS_TYPE4_FIELDS(AIS_ENCODE)
+	n = AIS_TYPE4_BITS;
+	break;
+    case 5: /* Ship static and voyage related data */
+	AIS_TYPE5_FIELDS(AIS_ENCODE)
+	PUTBITS(422, 1, ais->type5.dte);
+	n = AIS_TYPE5_BITS;
+	break;
+    case 9: /* Standard SAR Aircraft Position Report */
+	AIS_TYPE9_FIELDS(AIS_ENCODE)
+	n = AIS_TYPE9_BITS;
+	break;
+    case 10: /* UTC/Date inquiry */
+	AIS_TYPE10_FIELDS(AIS_ENCODE)
+	n = AIS_TYPE10_BITS;
+	break;
+    case 18:	/* Standard Class B CS Position Report */
+	AIS_TYPE18_FIELDS(AIS_ENCODE)
+	n = AIS_TYPE18_BITS;
+	break;
+    case 19:	/* Extended Class B CS Position Report */
+	AIS_TYPE19_FIELDS(AIS_ENCODE)
+	n = AIS_TYPE19_BITS;
+	break;
+    case 20:	/* Data Link Management Message, all four slots */
+	AIS_TYPE20_FIELDS(AIS_ENCODE)
+	n = AIS_TYPE20_BITS;
+	break;
+    case 21:	/* Aid-to-Navigation Report */
+	AIS_TYPE21_FIELDS(AIS_ENCODE)
+	n = AIS_TYPE21_BITS;
+	/* the name extension runs to the end of the message */
+	len = strlen(ais->type21.name);
+	if (len > 20) {
+	    to_sixbit(bits, 272, (int)(len - 20), ais->type21.name + 20);
+	    n += 6 * (len - 20);
+	}
+	break;
+    case 23:	/* Group Assignment Command */
+	AIS_TYPE23_FIELDS(AIS_ENCODE)
+	n = AIS_TYPE23_BITS;
+	break;
+    case 24:	/* Class B CS Static Data Report, one part at a time */
+	switch (ais->type24.part) {
+	case part_a:
+	    to_sixbit(bits, 40, 20, ais->type24.shipname);
+	    n = 160;
+	    break;
+	case part_b:
+	    PUTBITS(38, 2, 1);
+	    PUTBITS(40, 8, ais->type24.shiptype);
+	    /* the ITU-R 1371-4 layout: a 3-character vendor ID */
+	    to_sixbit(bits, 48, 3, ais->type24.vendorid);
+	    PUTBITS(66, 4, ais->type24.model);
+	    PUTBITS(70, 20, ais->type24.serial);
+	    to_sixbit(bits, 90, 7, ais->type24.callsign);
+	    if (AIS_AUXILIARY_MMSI(ais->mmsi)) {
+		PUTBITS(132, 30, ais->type24.mothership_mmsi);
+	    } else {
+		PUTBITS(132, 9, ais->type24.dim.to_bow);
+		PUTBITS(141, 9, ais->type24.dim.to_stern);
+		PUTBITS(150, 6, ais->type24.dim.to_port);
+		PUTBITS(156, 6, ais->type24.dim.to_starboard);
+	    }
+	    n = 168;
+	    break;
+	default:
+	    return false;
+	}
+	break;
+    case 27:	/* Long Range AIS Broadcast message */
+	AIS_TYPE27_FIELDS(AIS_ENCODE)
+	n = AIS_TYPE27_BITS;
+	break;
+    default:
+	/* binary payloads and variable layouts are not encoded */
+	return false;
+    }
+    /* *INDENT-ON* */
+#undef AIS_ENCODE
+#undef AIS_ENCODE_C
+#undef AIS_ENCODE_B
+#undef AIS_ENCODE_S
+#undef AIS_ENCODE_U
+#undef PUTBITS
+
+    *bitlen = n;
+    return true;
+}
+
+bool ais_position_decode(const unsigned char *bits, size_t bitlen,
+			 struct ais_position_t *pos)
+/* decode a position report straight into a compact record */
+{
+#define UBITS(s, l)	ubits_be(bits, s, l)
+/* extract a field at its ais_layout.h position */
+#define UFIELD(group, member)	ubits_be(bits, AIS_FIELD_AT(group, member))
+#define SFIELD(group, member)	sbits_be(bits, AIS_FIELD_AT(group, member))
+#define FLAG(group, member, flag) \
+	(UFIELD(group, member) != 0 ? (flag) : 0)
+    unsigned int speed, course;
+
+    (void)memset(pos, 0, sizeof(*pos));
+    pos->type = UBITS(0, 6);
+    pos->repeat = UBITS(6, 2);
+    pos->mmsi = UBITS(8, 30);
+
+    /* *INDENT-OFF* */
+    switch (pos->type) {
+    case 1:	/* Position Report */
+    case 2:
+    case 3:
+	if (bitlen < AIS_TYPE1_BITS)
+	    return false;
+	pos->status	= UFIELD(type1, status);
+	pos->turn	= SFIELD(type1, turn);
+	pos->speed	= UFIELD(type1, speed);
+	pos->lon	= SFIELD(type1, lon);
+	pos->lat	= SFIELD(type1, lat);
+	pos->course	= UFIELD(type1, course);
+	pos->heading	= UFIELD(type1, heading);
+	pos->second	= UFIELD(type1, second);
+	pos->radio	= UFIELD(type1, radio);
+	pos->flags	= FLAG(type1, accuracy, AIS_POSITION_ACCURACY)
+			| FLAG(type1, raim, AIS_POSITION_RAIM);
+	break;
+    case 18:	/* Standard Class B CS Position Report */
+	if (bitlen < AIS_TYPE18_BITS)
+	    return false;
+	pos->status	= AIS_POSITION_NO_STATUS;
+	pos->turn	= -128;
+	pos->speed	= UFIELD(type18, speed);
+	pos->lon	= SFIELD(type18, lon);
+	pos->lat	= SFIELD(type18, lat);
+	pos->course	= UFIELD(type18, course);
+	pos->heading	= UFIELD(type18, heading);
+	pos->second	= UFIELD(type18, second);
+	pos->radio	= UFIELD(type18, radio);
+	pos->flags	= FLAG(type18, accuracy, AIS_POSITION_ACCURACY)
+			| FLAG(type18, raim, AIS_POSITION_RAIM)
+			| FLAG(type18, assigned, AIS_POSITION_ASSIGNED)
+			| FLAG(type18, cs, AIS_POSITION_CS);
+	break;
+    case 19:	/* Extended Class B CS Position Report */
+	if (bitlen < AIS_TYPE19_BITS)
+	    return false;
+	pos->status	= AIS_POSITION_NO_STATUS;
+	pos->turn	= -128;
+	pos->speed	= UFIELD(type19, speed);
+	pos->lon	= SFIELD(type19, lon);
+	pos->lat	= SFIELD(type19, lat);
+	pos->course	= UFIELD(type19, course);
+	pos->heading	= UFIELD(type19, heading);
+	pos->second	= UFIELD(type19, second);
+	pos->flags	= FLAG(type19, accuracy, AIS_POSITION_ACCURACY)
+			| FLAG(type19, raim, AIS_POSITION_RAIM)
+			| FLAG(type19, assigned, AIS_POSITION_ASSIGNED);
+	break;
+    case 27:	/* Long Range AIS Broadcast message */
+	if (bitlen != AIS_TYPE27_BITS && bitlen != 168)
+	    return false;
+	/* scale to the type 1 units; not-available values map across */
+	pos->status	= UFIELD(type27, status);
+	pos->turn	= -128;
+	pos->lon	= SFIELD(type27, lon) * 1000;
+	pos->lat	= SFIELD(type27, lat) * 1000;
+	speed		= UFIELD(type27, speed);
+	pos->speed	= speed == AIS_LONGRANGE_SPEED_NOT_AVAILABLE
+			? AIS_SPEED_NOT_AVAILABLE : speed * 10;
+	course		= UFIELD(type27, course);
+	pos->course	= course == AIS_LONGRANGE_COURSE_NOT_AVAILABLE
+			? AIS_COURSE_NOT_AVAILABLE : course * 10;
+	pos->heading	= AIS_HEADING_NOT_AVAILABLE;
+	pos->second	= AIS_SEC_NOT_AVAILABLE;
+	pos->flags	= FLAG(type27, accuracy, AIS_POSITION_ACCURACY)
+			| FLAG(type27, raim, AIS_POSITION_RAIM)
+			| FLAG(type27, gnss, AIS_POSITION_GNSS);
+	break;
+    default:
+	return false;
+    }
+    /* *INDENT-ON* */
+#undef FLAG
+#undef SFIELD
+#undef UFIELD
+#undef UBITS
+
+    return true;
+}
 /*@ -charint @*/
 
 /* driver_ais.c ends here */
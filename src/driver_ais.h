@@ -1,9 +1,17 @@
 #ifndef DRIVER_AIS_H_
 #define DRIVER_AIS_H_
 
+#define AIS_ENCODE_BYTES	56	/* the longest encodable message, type 5 */
+
 bool ais_binary_decode(const int debug,
                        struct ais_t *ais,
                        const unsigned char *, size_t,
-                       /*@null@*/struct ais_type24_queue_t *);
+                       /*@null@*/struct ais_type24_queue_t *,
+                       /*@null@*/const uint32_t *skip_fields);
+/* the inverse of ais_binary_decode(), for the fixed layouts and type 24 */
+bool ais_binary_encode(const struct ais_t *ais,
+                       unsigned char *bits, size_t *bitlen);
+bool ais_position_decode(const unsigned char *, size_t,
+                         struct ais_position_t *pos);
 
 #endif
@@ -2,13 +2,24 @@
 #include <stdarg.h>
 #include <stdio.h>
 
-void gpsd_report(const int debuglevel, const int errlevel,
-                 const char *fmt, ...) {
+static gpsd_log_hook_t log_hook;
+static void *log_hook_userdata;
 
-  if (errlevel <= debuglevel) {
-    va_list ap;
-    va_start(ap, fmt);
+void gpsd_set_log_hook(gpsd_log_hook_t hook, void *userdata) {
+  log_hook = hook;
+  log_hook_userdata = userdata;
+}
+
+void gpsd_log(const int errlevel, const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  if (log_hook != NULL) {
+    char message[BUFSIZ];
+    (void)vsnprintf(message, sizeof(message), fmt, ap);
+    log_hook(errlevel, message, log_hook_userdata);
+  }
+  else {
     vprintf(fmt, ap);
-    va_end(ap);
   }
+  va_end(ap);
 }
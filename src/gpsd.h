@@ -1,4 +1,5 @@
 #ifndef GPSD_H_
+#define GPSD_H_
 
 #include <sys/types.h> // needed by driver_ais.c
 #include "ais.h" // needed by driver_ais.c
@@ -14,7 +15,31 @@
 #define LOG_SPIN	6	/* logging for catching spin bugs */
 #define LOG_RAW 	7	/* raw low-level I/O */
 
-void gpsd_report(const int debuglevel, const int errlevel, const char *fmt, ...);
+/*
+ * Messages above GPSD_MAX_LOG_LEVEL are compiled out, arguments and all;
+ * the rest are only formatted if errlevel is within the debug level
+ * passed at run time. Builds which never log past a level can define
+ * GPSD_MAX_LOG_LEVEL to it, e.g. -DGPSD_MAX_LOG_LEVEL=LOG_ERROR.
+ */
+#ifndef GPSD_MAX_LOG_LEVEL
+#define GPSD_MAX_LOG_LEVEL	LOG_RAW
+#endif
+
+#define gpsd_report(debuglevel, errlevel, ...) \
+    do { \
+	if ((errlevel) <= GPSD_MAX_LOG_LEVEL && (errlevel) <= (debuglevel)) \
+	    gpsd_log((errlevel), __VA_ARGS__); \
+    } while (0)
+
+void gpsd_log(const int errlevel, const char *fmt, ...);
+
+/*
+ * Messages go to stdout, unless a hook is set to receive them formatted.
+ * The hook is process-wide, and called from whichever thread decodes.
+ */
+typedef void (*gpsd_log_hook_t)(int errlevel, const char *message,
+				void *userdata);
+void gpsd_set_log_hook(gpsd_log_hook_t hook, void *userdata);
 
 #define MAX_PACKET_LENGTH	516	/* 7 + 506 + 3 */
 extern /*@ observer @*/ const char *gpsd_hexdump(/*@out@*/char *, size_t,
@@ -180,6 +180,527 @@ describe('aisdecoder', function() {
                   });
     });
   });
+  describe('decoding from a Buffer', function() {
+    it('decodes in place using offset and length', function() {
+      var sentence = '!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C';
+      var buf = new Buffer('xx' + sentence + 'yyyy');
+      var res = new AisDecoder().decode(buf, 2, sentence.length);
+      res.mmsi.should.equal(477553000);
+      res.lat.should.equal(47.58283333333333);
+    });
+  });
+  describe('batch decoding', function() {
+    var type1 = '!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C';
+    var type5 = ['!AIVDM,2,1,1,A,55?MbV02;H;s<HtKR20EHE:0@T4@Dn2222222216L961O5Gf0NSQEp6ClRp8,0*1C',
+                 '!AIVDM,2,2,1,A,88888888880,2*25'];
+    it('decodes an array of sentences', function() {
+      var res = new AisDecoder().decodeBatch([type1].concat(type5));
+      res.length.should.equal(2);
+      res[0].mmsi.should.equal(477553000);
+      res[1].shipname.should.equal('EVER DIADEM');
+    });
+    it('decodes a newline-delimited string', function() {
+      var res = new AisDecoder().decodeBatch([type1].concat(type5).join('\r\n') + '\r\n');
+      res.length.should.equal(2);
+      res[0].type.should.equal('PositionReportClassA');
+      res[1].type.should.equal('StaticAndVoyageRelatedData');
+    });
+    it('decodes a newline-delimited Buffer', function() {
+      var res = new AisDecoder().decodeBatch(new Buffer([type1, type1].join('\n')));
+      res.length.should.equal(2);
+      res[1].mmsi.should.equal(477553000);
+    });
+  });
+  describe('asynchronous decoding', function() {
+    var type5 = ['!AIVDM,2,1,1,A,55?MbV02;H;s<HtKR20EHE:0@T4@Dn2222222216L961O5Gf0NSQEp6ClRp8,0*1C',
+                 '!AIVDM,2,2,1,A,88888888880,2*25'];
+    it('calls back with the decoded messages', function(done) {
+      new AisDecoder().decodeAsync(type5, function(err, res) {
+        should.not.exist(err);
+        res.length.should.equal(1);
+        res[0].shipname.should.equal('EVER DIADEM');
+        done();
+      });
+    });
+    it('reassembles multipart messages across batches in order', function(done) {
+      var d = new AisDecoder();
+      var calls = [];
+      d.decodeAsync([type5[0]], function(err, res) {
+        res.length.should.equal(0);
+        calls.push(1);
+      });
+      d.decodeAsync(new Buffer(type5[1]), function(err, res) {
+        calls.should.eql([1]);
+        res.length.should.equal(1);
+        res[0].mmsi.should.equal(351759000);
+        done();
+      });
+    });
+    it('leaves the decoder usable while a large batch is decoded', function(done) {
+      var d = new AisDecoder();
+      var lines = [];
+      for (var i = 0; i < 1000; i++) {
+        lines.push('!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C', type5[0], type5[1]);
+      }
+      var pending = 2;
+      function check(err, res) {
+        should.not.exist(err);
+        res.length.should.equal(2000);
+        res[res.length - 1].shipname.should.equal('EVER DIADEM');
+        if (--pending == 0) done();
+      }
+      d.decodeAsync(lines, check);
+      d.decodeAsync(lines.join('\r\n'), check);
+      d.stats().should.be.an.Object;
+      d.decode('!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C').mmsi.should.equal(477553000);
+    });
+  });
+  describe('stream decoding', function() {
+    var data = 'garbage\r\n!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C\r\n' +
+      '!AIVDM,2,1,1,A,55?MbV02;H;s<HtKR20EHE:0@T4@Dn2222222216L961O5Gf0NSQEp6ClRp8,0*1C\r\n' +
+      '!AIVDM,2,2,1,A,88888888880,2*25';
+    it('decodes sentences split across chunks', function() {
+      var d = new AisDecoder();
+      var res = [];
+      for (var i = 0; i < data.length; i += 7) {
+        res = res.concat(d.decodeChunk(new Buffer(data.slice(i, i + 7))));
+      }
+      res = res.concat(d.decodeChunk('\n'));
+      res.length.should.equal(2);
+      res[0].mmsi.should.equal(477553000);
+      res[1].shipname.should.equal('EVER DIADEM');
+    });
+    it('works as a Transform stream', function(done) {
+      var s = new aisdecoder.AisDecodeStream();
+      var res = [];
+      s.on('data', function(obj) { res.push(obj); });
+      s.on('end', function() {
+        res.length.should.equal(2);
+        res[1].type.should.equal('StaticAndVoyageRelatedData');
+        done();
+      });
+      s.write(new Buffer(data.slice(0, 50)));
+      s.end(new Buffer(data.slice(50)));
+    });
+  });
+  describe('field selection', function() {
+    var type1 = '!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C';
+    it('only sets the selected fields', function() {
+      var d = new AisDecoder({ fields: ['mmsi', 'lat', 'lon', 'speed', 'course', 'heading'] });
+      d.decode(type1).should.eql({
+        type: 'PositionReportClassA',
+        mmsi: 477553000,
+        lat: 47.58283333333333,
+        lon: -122.34583333333333,
+        speed: 0.0,
+        course: 51.0,
+        heading: 181.0
+      });
+    });
+    it('selects fields by message type', function() {
+      var d = new AisDecoder({ fields: { 5: ['shipname'] } });
+      d.decode(type1).radio.should.equal(149208);
+      var res = d.decodeBatch(['!AIVDM,2,1,1,A,55?MbV02;H;s<HtKR20EHE:0@T4@Dn2222222216L961O5Gf0NSQEp6ClRp8,0*1C',
+                               '!AIVDM,2,2,1,A,88888888880,2*25']);
+      res[0].shipname.should.equal('EVER DIADEM');
+      should.not.exist(res[0].callsign);
+      should.not.exist(res[0].mmsi);
+    });
+    it('rejects unknown field names', function() {
+      (function() { new AisDecoder({ fields: ['mmsi', 'lattitude'] }); }).should.throw(/lattitude/);
+      (function() { new AisDecoder({ fields: { 1: ['shipname'] } }); }).should.throw(/shipname for type 1/);
+      (function() { new AisDecoder({ fields: ['mmsi', 5] }); }).should.throw(TypeError);
+      // a field of any type is allowed in the array form
+      new AisDecoder({ fields: ['shipname', 'lat'] }).decode(type1).lat.should.equal(47.58283333333333);
+    });
+  });
+  describe('type selection', function() {
+    it('only decodes the selected message types', function() {
+      var d = new AisDecoder({ types: [5] });
+      var res = d.decodeBatch(['!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C',
+                               '!AIVDM,2,1,1,A,55?MbV02;H;s<HtKR20EHE:0@T4@Dn2222222216L961O5Gf0NSQEp6ClRp8,0*1C',
+                               '!AIVDM,2,2,1,A,88888888880,2*25']);
+      res.length.should.equal(1);
+      res[0].shipname.should.equal('EVER DIADEM');
+    });
+    it('drops all fragments of filtered multipart messages', function() {
+      var d = new AisDecoder({ types: [1] });
+      var res = d.decodeBatch(['!AIVDM,2,1,1,A,55?MbV02;H;s<HtKR20EHE:0@T4@Dn2222222216L961O5Gf0NSQEp6ClRp8,0*1C',
+                               '!AIVDM,2,2,1,A,88888888880,2*25',
+                               '!AIVDM,1,1,,A,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C']);
+      res.length.should.equal(1);
+      res[0].mmsi.should.equal(477553000);
+      d.stats().rejected.filtered.should.equal(2);
+    });
+    it('counts fragments buffered before a filtered fragment 1', function() {
+      var d = new AisDecoder({ types: [1] });
+      d.decodeBatch(['!AIVDM,2,2,1,A,88888888880,2*25',
+                     '!AIVDM,2,1,1,A,55?MbV02;H;s<HtKR20EHE:0@T4@Dn2222222216L961O5Gf0NSQEp6ClRp8,0*1C']);
+      var stats = d.stats();
+      stats.rejected.filtered.should.equal(2);
+      stats.reassembly.should.eql({completed: 0, expired: 0, evicted: 0, dropped: 0});
+    });
+  });
+  describe('position records', function() {
+    var type1 = '!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C';
+    var type5 = ['!AIVDM,2,1,1,A,55?MbV02;H;s<HtKR20EHE:0@T4@Dn2222222216L961O5Gf0NSQEp6ClRp8,0*1C',
+                 '!AIVDM,2,2,1,A,88888888880,2*25'];
+    var type27 = '!AIVDM,1,1,,B,KC5E2b@U19PFdLbMuc5=ROv62<7m,0*16';
+    it('decodes position reports into compact records', function() {
+      var records = new aisdecoder.PositionRecords(4);
+      new AisDecoder().decodePositions([type1].concat(type5, [type27]), records).should.equal(2);
+      records.length.should.equal(2);
+      records.type(0).should.equal(1);
+      records.mmsi(0).should.equal(477553000);
+      records.lat(0).should.equal(47.58283333333333);
+      records.lon(0).should.equal(-122.34583333333333);
+      records.course(0).should.equal(51.0);
+      records.heading(0).should.equal(181);
+      records.radio(0).should.equal(149208);
+      records.type(1).should.equal(27);
+      records.mmsi(1).should.equal(206914217);
+      records.lat(1).should.equal(4.84);
+      records.speed(1).should.equal(57.0);
+      records.course(1).should.equal(167.0);
+      records.heading(1).should.equal(511);
+    });
+    it('stops when the records are full', function() {
+      var records = new aisdecoder.PositionRecords(1);
+      var d = new AisDecoder();
+      d.decodePositions([type1, type1].join('\n'), records).should.equal(1);
+      d.decodePositions(type1, records).should.equal(0);
+      records.length.should.equal(1);
+    });
+  });
+  describe('columnar decoding', function() {
+    var type1 = '!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C';
+    var type18 = '!AIVDM,1,1,,B,B69>7mh0?J<:>05B0`0e;wq2PHI8,0*3D';
+    it('writes each member into its own typed array', function() {
+      var columns = new aisdecoder.PositionColumns(2);
+      var d = new AisDecoder();
+      d.decodeColumns([type1], columns).should.equal(1);
+      d.decodeColumns(type18 + '\n' + type1, columns).should.equal(1);
+      columns.length.should.equal(2);
+      columns.mmsi[0].should.equal(477553000);
+      columns.lat[0].should.equal(28549700);
+      columns.course[0].should.equal(510);
+      columns.type[0].should.equal(1);
+      columns.type[1].should.equal(18);
+      columns.status[1].should.equal(15);
+    });
+    it('only fills the columns given', function() {
+      var mmsi = new Uint32Array(1);
+      new AisDecoder().decodeColumns([type1], { mmsi: mmsi }).should.equal(1);
+      mmsi[0].should.equal(477553000);
+    });
+    it('rejects columns of the wrong type', function() {
+      (function() {
+        new AisDecoder().decodeColumns([type1], { mmsi: new Int32Array(1) });
+      }).should.throw(/Uint32Array/);
+    });
+  });
+  describe('multi-source reassembly', function() {
+    var type5 = ['!AIVDM,2,1,1,A,55?MbV02;H;s<HtKR20EHE:0@T4@Dn2222222216L961O5Gf0NSQEp6ClRp8,0*1C',
+                 '!AIVDM,2,2,1,A,88888888880,2*25'];
+    it('keeps interleaved fragments of different sources apart', function() {
+      var d = new AisDecoder();
+      d.setSource(1);
+      should.not.exist(d.decode(type5[0]));
+      d.setSource(2);
+      should.not.exist(d.decode(type5[0]));
+      d.decode('!AIVDM,1,1,,A,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C').mmsi.should.equal(477553000);
+      d.decode(type5[1]).shipname.should.equal('EVER DIADEM');
+      d.setSource(1);
+      d.decode(type5[1]).shipname.should.equal('EVER DIADEM');
+    });
+    it('counts the fragment window per source', function() {
+      var d = new AisDecoder({fragmentWindow: 2});
+      d.setSource(1);
+      d.decode(type5[0]);
+      d.setSource(257);
+      for (var i = 0; i < 10; i++) d.decode('!AIVDM,1,1,,A,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C');
+      d.setSource(1);
+      d.decode(type5[1]).shipname.should.equal('EVER DIADEM');
+    });
+    it('spreads the messages of many sources over both channels', function() {
+      var typeB = ['!AIVDM,2,1,1,B,55?MbV02;H;s<HtKR20EHE:0@T4@Dn2222222216L961O5Gf0NSQEp6ClRp8,0*1F',
+                   '!AIVDM,2,2,1,B,88888888880,2*26'];
+      var d = new AisDecoder();
+      var source;
+      // sources differing only above their low byte, 32 messages in flight
+      for (source = 1; source < 16 * 256; source += 256) {
+        d.setSource(source);
+        d.decode(type5[0]);
+        d.decode(typeB[0]);
+      }
+      for (source = 1; source < 16 * 256; source += 256) {
+        d.setSource(source);
+        d.decode(type5[1]).shipname.should.equal('EVER DIADEM');
+        d.decode(typeB[1]).shipname.should.equal('EVER DIADEM');
+      }
+      var stats = d.reassemblyStats();
+      stats.completed.should.equal(32);
+      stats.evicted.should.equal(0);
+    });
+  });
+  describe('out-of-order reassembly', function() {
+    var type5 = ['!AIVDM,2,1,1,A,55?MbV02;H;s<HtKR20EHE:0@T4@Dn2222222216L961O5Gf0NSQEp6ClRp8,0*1C',
+                 '!AIVDM,2,2,1,A,88888888880,2*25'];
+    var type1 = '!AIVDM,1,1,,A,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C';
+    it('joins fragments arriving in reverse order', function() {
+      var d = new AisDecoder();
+      should.not.exist(d.decode(type5[1]));
+      d.decode(type5[0]).shipname.should.equal('EVER DIADEM');
+      d.reassemblyStats().completed.should.equal(1);
+    });
+    it('expires incomplete messages after fragmentWindow sentences', function() {
+      var d = new AisDecoder({fragmentWindow: 2});
+      should.not.exist(d.decode(type5[1]));
+      d.decode(type1);
+      d.decode(type1);
+      should.not.exist(d.decode(type5[0]));
+      var stats = d.reassemblyStats();
+      stats.expired.should.equal(1);
+      stats.dropped.should.equal(1);
+      stats.completed.should.equal(0);
+    });
+    it('does not count fragments of completed messages as dropped', function() {
+      var d = new AisDecoder();
+      for (var i = 0; i < 2; i++) {
+        should.not.exist(d.decode(type5[0]));
+        d.decode(type5[1]).shipname.should.equal('EVER DIADEM');
+      }
+      var stats = d.reassemblyStats();
+      stats.completed.should.equal(2);
+      stats.dropped.should.equal(0);
+    });
+    it('rejects a non-numeric fragmentTimeout', function() {
+      (function() { new AisDecoder({fragmentTimeout: 'soon'}); }).should.throw(TypeError);
+    });
+  });
+  describe('checksum verification', function() {
+    var good = '!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C';
+    var bad = '!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKI,0*5C';
+    it('is off by default', function() {
+      var d = new AisDecoder();
+      d.decode(bad).mmsi.should.equal(477553000);
+      d.checksumErrors().should.equal(0);
+    });
+    it('rejects and counts corrupted sentences', function() {
+      var d = new AisDecoder({verifyChecksum: true});
+      d.decode(good).mmsi.should.equal(477553000);
+      should.not.exist(d.decode(bad));
+      should.not.exist(d.decode('!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0'));
+      d.checksumErrors().should.equal(2);
+    });
+  });
+  describe('decoder statistics', function() {
+    it('counts decoded messages by type and rejects by reason', function() {
+      var d = new AisDecoder({types: [1, 5]});
+      d.decode('!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C');
+      d.decode('!AIVDM,1,1,,B,B69>7mh0?J<:>05B0`0e;wq2PHI8,0*3D');
+      d.decode('!AIVDM,1,1,,C,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C');
+      d.decode('!AIVDM,1,1,,B');
+      d.decode('!AIVDM,1,1,,A,G02bBUP<3HluhGja`UV00000900,2*54');
+      var stats = d.stats();
+      stats.sentences.should.equal(5);
+      stats.decoded.should.eql({1: 1});
+      stats.rejected.filtered.should.equal(2);
+      stats.rejected.channel.should.equal(1);
+      stats.rejected.malformed.should.equal(1);
+      stats.timing.samples.should.equal(1);
+      stats.timing.histogram.length.should.equal(16);
+    });
+    it('are zeroed by resetStats()', function() {
+      var d = new AisDecoder();
+      should.not.exist(d.decode('!AIVDM,1,1,,B,177KQJ5000G?tO,0*5C'));
+      d.stats().undecoded.should.eql({1: 1});
+      d.resetStats();
+      d.stats().sentences.should.equal(0);
+      d.stats().undecoded.should.eql({});
+    });
+  });
+  describe('file decoding', function() {
+    var fs = require('fs');
+    var os = require('os');
+    var path = require('path');
+    var file = path.join(os.tmpdir(), 'aisdecoder-test-' + process.pid + '.nmea');
+    var lines = [];
+    // Several chunks' worth, so multipart messages straddle chunk boundaries
+    for (var i = 0; i < 4000; i++) {
+      lines.push('!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C',
+                 '!AIVDM,2,1,1,A,55?MbV02;H;s<HtKR20EHE:0@T4@Dn2222222216L961O5Gf0NSQEp6ClRp8,0*1C',
+                 '!AIVDM,2,2,1,A,88888888880,2*25');
+    }
+    before(function() {
+      fs.writeFileSync(file, lines.join('\n') + '\n');
+    });
+    after(function() {
+      fs.unlinkSync(file);
+    });
+    it('decodes in file order on several threads', function(done) {
+      var d = new AisDecoder();
+      var results = [];
+      d.decodeFile(file, {threads: 4}, function(batch) {
+        results = results.concat(batch);
+      }, function(err, count) {
+        should.not.exist(err);
+        count.should.equal(8000);
+        results.should.eql(new AisDecoder().decodeBatch(lines));
+        d.stats().decoded.should.eql({1: 4000, 5: 4000});
+        done();
+      });
+    });
+    it('joins fragments as a single decoder would at any chunk boundary', function(done) {
+      // Distinct second fragments, after 0-2 lines shifting where chunks start
+      var varied = [];
+      for (var i = 0; i < 4000; i++) {
+        varied.push(lines[3 * i], lines[3 * i + 1],
+                    '!AIVDM,2,2,1,A,8888888888' + (i % 10) + ',2*25');
+      }
+      (function next(p) {
+        if (p == 3) return done();
+        var data = new Array(p + 1).join(lines[0] + '\n') + varied.join('\n') + '\n';
+        fs.writeFileSync(file, data);
+        var results = [];
+        new AisDecoder().decodeFile(file, {threads: 3}, function(batch) {
+          results = results.concat(batch);
+        }, function(err, count) {
+          should.not.exist(err);
+          results.should.eql(new AisDecoder().decodeBatch(data));
+          next(p + 1);
+        });
+      })(0);
+    });
+    it('passes an error for a missing file', function(done) {
+      new AisDecoder().decodeFile(file + '.missing', function() {}, function(err) {
+        err.should.be.an.instanceOf(Error);
+        done();
+      });
+    });
+  });
+  describe('tag blocks', function() {
+    var type1 = '!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C';
+    it('are parsed into the tagblock property', function() {
+      var obj = new AisDecoder().decode('\\s:station1,c:1700000000*71\\' + type1);
+      obj.mmsi.should.equal(477553000);
+      obj.tagblock.should.eql({time: 1700000000, source: 'station1'});
+      should.not.exist(new AisDecoder().decode(type1).tagblock);
+    });
+    it('reject sentences with a bad checksum', function() {
+      var d = new AisDecoder();
+      should.not.exist(d.decode('\\s:station1,c:1700000000*70\\' + type1));
+      should.not.exist(d.decode('\\s:station1,c:1700000000*71' + type1));
+      d.stats().rejected.tagblock.should.equal(2);
+    });
+    it('carry the time and source of a group to its last sentence', function() {
+      var results = new AisDecoder().decodeBatch(
+        ['\\g:1-2-42,s:rx7,c:1700000001*72\\!AIVDM,2,1,1,A,55?MbV02;H;s<HtKR20EHE:0@T4@Dn2222222216L961O5Gf0NSQEp6ClRp8,0*1C',
+         '\\g:2-2-42*5B\\!AIVDM,2,2,1,A,88888888880,2*25']);
+      results.length.should.equal(1);
+      results[0].tagblock.should.eql({time: 1700000001, source: 'rx7',
+                                      group: {sentence: 2, count: 2, id: 42}});
+    });
+    it('are framed in byte streams', function() {
+      var d = new AisDecoder();
+      var data = 'garbage\r\n\\s:station1,c:1700000000*71\\' + type1 + '\r\n';
+      var results = [];
+      for (var i = 0; i < data.length; i += 7) {
+        results = results.concat(d.decodeChunk(data.slice(i, i + 7)));
+      }
+      results.length.should.equal(1);
+      results[0].tagblock.source.should.equal('station1');
+    });
+    it('are kept by asynchronous decoding', function(done) {
+      new AisDecoder().decodeAsync(['\\s:station1,c:1700000000*71\\' + type1, type1], function(err, res) {
+        should.not.exist(err);
+        res.length.should.equal(2);
+        res[0].tagblock.should.eql({time: 1700000000, source: 'station1'});
+        should.not.exist(res[1].tagblock);
+        done();
+      });
+    });
+    it('are kept by file decoding', function(done) {
+      var fs = require('fs');
+      var os = require('os');
+      var path = require('path');
+      var file = path.join(os.tmpdir(), 'aisdecoder-tagblock-' + process.pid + '.nmea');
+      fs.writeFileSync(file,
+        '\\g:1-2-42,s:rx7,c:1700000001*72\\!AIVDM,2,1,1,A,55?MbV02;H;s<HtKR20EHE:0@T4@Dn2222222216L961O5Gf0NSQEp6ClRp8,0*1C\n' +
+        '\\g:2-2-42*5B\\!AIVDM,2,2,1,A,88888888880,2*25\n' +
+        '\\s:station1,c:1700000000*71\\' + type1 + '\n');
+      var results = [];
+      new AisDecoder().decodeFile(file, function(batch) {
+        results = results.concat(batch);
+      }, function(err, count) {
+        fs.unlinkSync(file);
+        should.not.exist(err);
+        count.should.equal(2);
+        results[0].tagblock.should.eql({time: 1700000001, source: 'rx7',
+                                        group: {sentence: 2, count: 2, id: 42}});
+        results[1].tagblock.should.eql({time: 1700000000, source: 'station1'});
+        done();
+      });
+    });
+  });
+  describe('vessel table', function() {
+    var type5 = ['!AIVDM,2,1,1,A,55?MbV02;H;s<HtKR20EHE:0@T4@Dn2222222216L961O5Gf0NSQEp6ClRp8,0*1C',
+                 '!AIVDM,2,2,1,A,88888888880,2*25'];
+    var position = '!AIVDM,1,1,,A,15?MbV0P1uIT0l0A:`P:S8Lt0000,0*13';
+    var noPosition = '!AIVDM,1,1,,B,15?MbV0P00<tSF0l4Q@:S8Lt0000,0*4A';
+    it('merges position reports with static data', function() {
+      var d = new AisDecoder({vessels: 100});
+      should.not.exist(d.vessel(351759000));
+      d.decodeBatch(type5.concat([position]));
+      d.vessel(351759000).should.eql({
+        mmsi: 351759000, updated: 2,
+        lat: 30, lon: -90, speed: 12.5, course: 270, heading: 270,
+        status: 0, second: 30, accuracy: false,
+        imo: 9134270, callsign: '3FOF8', shipname: 'EVER DIADEM', shiptype: 70,
+        to_bow: 225, to_stern: 70, to_port: 1, to_starboard: 31, epfd: 1,
+        destination: 'NEW YORK', draught: 12.2, eta: '05-15T14:00Z'
+      });
+      d.decode(noPosition);
+      var v = d.vessel(351759000);
+      v.lat.should.equal(30);
+      v.speed.should.equal(0);
+      v.updated.should.equal(3);
+    });
+    it('lists the vessels updated since', function() {
+      var d = new AisDecoder({vessels: 100});
+      d.decode('!AIVDM,1,1,,B,177KQJ5000G?tO`K>RA1wUbN0TKH,0*5C');
+      var since = d.vesselUpdates();
+      d.decodeBatch(type5);
+      d.vessels().length.should.equal(2);
+      var changed = d.vessels(since);
+      changed.length.should.equal(1);
+      changed[0].mmsi.should.equal(351759000);
+      d.expireVessels(since).should.equal(1);
+      should.not.exist(d.vessel(477553000));
+      d.vessels().length.should.equal(1);
+    });
+    it('merges only the selected fields', function() {
+      var type19 = '!AIVDM,1,1,,A,C5?MbV00I6I0=04Bb80p@e50:d:U08B28:J000000000S>4S0gR0,0*5F';
+      var d = new AisDecoder({fields: {1: ['mmsi', 'speed'], 5: ['mmsi', 'draught']}, vessels: 100});
+      d.decode(position);
+      d.vessel(351759000).should.eql({mmsi: 351759000, updated: 1, speed: 12.5, accuracy: false});
+      d.decode(type19);
+      d.decode(position);
+      d.decodeBatch(type5);
+      d.vessel(351759000).should.eql({
+        mmsi: 351759000, updated: 4,
+        lat: 30, lon: -90, speed: 12.5, course: 90, heading: 90,
+        second: 10, accuracy: false,
+        shipname: 'EVER DIADEM', shiptype: 70,
+        to_bow: 225, to_stern: 70, to_port: 1, to_starboard: 31, epfd: 1,
+        draught: 12.2
+      });
+    });
+    it('is only kept when asked for', function() {
+      (function() { new AisDecoder().vessels(); }).should.throw();
+      (function() { new AisDecoder({vessels: 0}); }).should.throw();
+    });
+  });
   describe('decoding type 23 message',
  function() {
     it('is unsupported', function() {